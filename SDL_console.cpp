@@ -4,12 +4,22 @@
 #include <SDL2/SDL_image.h>
 #include <algorithm>
 #include <assert.h>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory_resource>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -18,9 +28,20 @@
 #include <utility>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "SDL_console.h"
 
 #define CONSOLE_SDL_LINK_AT_RUNTIME 0
+
+/* Build with -DCONSOLE_ENABLE_TRACE=1 for Console_DumpTrace(). */
+#ifndef CONSOLE_ENABLE_TRACE
+#define CONSOLE_ENABLE_TRACE 0
+#endif
 namespace console {
 
 #if defined(CONSOLE_SDL_LINK_AT_RUNTIME) && (CONSOLE_SDL_LINK_AT_RUNTIME) == 1
@@ -44,13 +65,14 @@ CONSOLE_DEFINE_SYMBOL(SDL_free);
 CONSOLE_DEFINE_SYMBOL(SDL_FreeSurface);
 CONSOLE_DEFINE_SYMBOL(SDL_GetClipboardText);
 CONSOLE_DEFINE_SYMBOL(SDL_GetError);
+CONSOLE_DEFINE_SYMBOL(SDL_GetHint);
 CONSOLE_DEFINE_SYMBOL(SDL_GetEventFilter);
 CONSOLE_DEFINE_SYMBOL(SDL_GetModState);
+CONSOLE_DEFINE_SYMBOL(SDL_GetRendererInfo);
 CONSOLE_DEFINE_SYMBOL(SDL_GetRendererOutputSize);
 CONSOLE_DEFINE_SYMBOL(SDL_GetWindowFlags);
 CONSOLE_DEFINE_SYMBOL(SDL_GetWindowID);
 CONSOLE_DEFINE_SYMBOL(SDL_HideWindow);
-CONSOLE_DEFINE_SYMBOL(SDL_iconv_string);
 CONSOLE_DEFINE_SYMBOL(SDL_InitSubSystem);
 CONSOLE_DEFINE_SYMBOL(SDL_MapRGB);
 CONSOLE_DEFINE_SYMBOL(SDL_memset);
@@ -58,7 +80,9 @@ CONSOLE_DEFINE_SYMBOL(SDL_RenderClear);
 CONSOLE_DEFINE_SYMBOL(SDL_RenderCopy);
 CONSOLE_DEFINE_SYMBOL(SDL_RenderDrawRect);
 CONSOLE_DEFINE_SYMBOL(SDL_RenderFillRect);
+CONSOLE_DEFINE_SYMBOL(SDL_RenderFillRects);
 CONSOLE_DEFINE_SYMBOL(SDL_RenderPresent);
+CONSOLE_DEFINE_SYMBOL(SDL_RenderReadPixels);
 CONSOLE_DEFINE_SYMBOL(SDL_RenderSetIntegerScale);
 CONSOLE_DEFINE_SYMBOL(SDL_RenderSetViewport);
 CONSOLE_DEFINE_SYMBOL(SDL_PointInRect);
@@ -66,9 +90,11 @@ CONSOLE_DEFINE_SYMBOL(SDL_SetClipboardText);
 CONSOLE_DEFINE_SYMBOL(SDL_SetColorKey);
 CONSOLE_DEFINE_SYMBOL(SDL_SetEventFilter);
 CONSOLE_DEFINE_SYMBOL(SDL_SetHint);
+CONSOLE_DEFINE_SYMBOL(SDL_SetRenderTarget);
 CONSOLE_DEFINE_SYMBOL(SDL_SetRenderDrawColor);
 CONSOLE_DEFINE_SYMBOL(SDL_SetTextureBlendMode);
 CONSOLE_DEFINE_SYMBOL(SDL_SetTextureColorMod);
+CONSOLE_DEFINE_SYMBOL(SDL_SetThreadPriority);
 CONSOLE_DEFINE_SYMBOL(SDL_SetWindowMinimumSize);
 CONSOLE_DEFINE_SYMBOL(SDL_ShowWindow);
 CONSOLE_DEFINE_SYMBOL(SDL_StartTextInput);
@@ -105,13 +131,14 @@ void resolve_symbols(Console_SymResolverProc resolver)
         CONSOLE_ADD_SYMBOL(SDL_FreeSurface),
         CONSOLE_ADD_SYMBOL(SDL_GetClipboardText),
         CONSOLE_ADD_SYMBOL(SDL_GetError),
+        CONSOLE_ADD_SYMBOL(SDL_GetHint),
         CONSOLE_ADD_SYMBOL(SDL_GetEventFilter),
         CONSOLE_ADD_SYMBOL(SDL_GetModState),
+        CONSOLE_ADD_SYMBOL(SDL_GetRendererInfo),
         CONSOLE_ADD_SYMBOL(SDL_GetRendererOutputSize),
         CONSOLE_ADD_SYMBOL(SDL_GetWindowFlags),
         CONSOLE_ADD_SYMBOL(SDL_GetWindowID),
         CONSOLE_ADD_SYMBOL(SDL_HideWindow),
-        CONSOLE_ADD_SYMBOL(SDL_iconv_string),
         CONSOLE_ADD_SYMBOL(SDL_InitSubSystem),
         CONSOLE_ADD_SYMBOL(SDL_MapRGB),
         CONSOLE_ADD_SYMBOL(SDL_memset),
@@ -119,7 +146,9 @@ void resolve_symbols(Console_SymResolverProc resolver)
         CONSOLE_ADD_SYMBOL(SDL_RenderCopy),
         CONSOLE_ADD_SYMBOL(SDL_RenderDrawRect),
         CONSOLE_ADD_SYMBOL(SDL_RenderFillRect),
+        CONSOLE_ADD_SYMBOL(SDL_RenderFillRects),
         CONSOLE_ADD_SYMBOL(SDL_RenderPresent),
+        CONSOLE_ADD_SYMBOL(SDL_RenderReadPixels),
         CONSOLE_ADD_SYMBOL(SDL_RenderSetIntegerScale),
         CONSOLE_ADD_SYMBOL(SDL_RenderSetViewport),
         CONSOLE_ADD_SYMBOL(SDL_PointInRect),
@@ -127,9 +156,11 @@ void resolve_symbols(Console_SymResolverProc resolver)
         CONSOLE_ADD_SYMBOL(SDL_SetColorKey),
         CONSOLE_ADD_SYMBOL(SDL_SetEventFilter),
         CONSOLE_ADD_SYMBOL(SDL_SetHint),
+        CONSOLE_ADD_SYMBOL(SDL_SetRenderTarget),
         CONSOLE_ADD_SYMBOL(SDL_SetRenderDrawColor),
         CONSOLE_ADD_SYMBOL(SDL_SetTextureBlendMode),
         CONSOLE_ADD_SYMBOL(SDL_SetTextureColorMod),
+        CONSOLE_ADD_SYMBOL(SDL_SetThreadPriority),
         CONSOLE_ADD_SYMBOL(SDL_SetWindowMinimumSize),
         CONSOLE_ADD_SYMBOL(SDL_ShowWindow),
         CONSOLE_ADD_SYMBOL(SDL_StartTextInput),
@@ -147,6 +178,342 @@ void resolve_symbols(Console_SymResolverProc resolver)
 
 static constexpr size_t default_scrollback = 1024;
 
+using Clock = std::chrono::steady_clock;
+
+#if CONSOLE_ENABLE_TRACE
+/*
+ * Scoped trace probes, written out by Console_DumpTrace() as Chrome
+ * trace_event JSON. Each thread records into its own ring, overwriting the
+ * oldest events. A slot's sequence number is odd while it is written, so
+ * the dump can skip slots that change under it without taking a lock.
+ * Timestamps are steady_clock microseconds.
+ */
+namespace trace {
+    struct Slot {
+        std::atomic<Uint64> seq { 0 };
+        std::atomic<const char*> name { nullptr };
+        std::atomic<Uint64> start_ns { 0 };
+        std::atomic<Uint64> dur_ns { 0 };
+    };
+
+    struct Ring {
+        static constexpr Uint64 capacity = 1 << 14;
+        std::array<Slot, capacity> slots;
+        std::atomic<Uint64> head { 0 };
+        std::atomic<const char*> thread_name { nullptr };
+        int tid { 0 };
+
+        void record(const char* name, Uint64 start, Uint64 dur)
+        {
+            Uint64 h = head.load(std::memory_order_relaxed);
+            Slot& s = slots[h % capacity];
+            s.seq.store(2 * h + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.name.store(name, std::memory_order_relaxed);
+            s.start_ns.store(start, std::memory_order_relaxed);
+            s.dur_ns.store(dur, std::memory_order_relaxed);
+            s.seq.store(2 * h + 2, std::memory_order_release);
+            head.store(h + 1, std::memory_order_release);
+        }
+    };
+
+    // Rings outlive their threads so a dump still has them
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Ring>> rings;
+    };
+
+    static Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    static Ring& ring()
+    {
+        thread_local std::shared_ptr<Ring> r = [] {
+            auto ring = std::make_shared<Ring>();
+            auto& reg = registry();
+            std::scoped_lock lock(reg.mutex);
+            ring->tid = static_cast<int>(reg.rings.size()) + 1;
+            reg.rings.push_back(ring);
+            return ring;
+        }();
+        return *r;
+    }
+
+    static Uint64 now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    struct Scope {
+        Scope(const char* name)
+            : name(name)
+            , start(now_ns())
+        {
+        }
+
+        ~Scope()
+        {
+            ring().record(name, start, now_ns() - start);
+        }
+
+        const char* name;
+        Uint64 start;
+    };
+
+    static bool dump(const char* path)
+    {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+
+        std::vector<std::shared_ptr<Ring>> rings;
+        {
+            std::scoped_lock lock(registry().mutex);
+            rings = registry().rings;
+        }
+
+        char buf[256];
+        const char* sep = "";
+        out << "{\"traceEvents\":[";
+        for (auto& r : rings) {
+            if (const char* tn = r->thread_name.load()) {
+                std::snprintf(buf, sizeof(buf), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    sep, r->tid, tn);
+                out << buf;
+                sep = ",";
+            }
+
+            const Uint64 head = r->head.load(std::memory_order_acquire);
+            for (Uint64 h = head > Ring::capacity ? head - Ring::capacity : 0; h < head; ++h) {
+                Slot& s = r->slots[h % Ring::capacity];
+                Uint64 seq = s.seq.load(std::memory_order_acquire);
+                const char* name = s.name.load(std::memory_order_relaxed);
+                Uint64 start = s.start_ns.load(std::memory_order_relaxed);
+                Uint64 dur = s.dur_ns.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                // Overwritten since head was read
+                if (seq != 2 * h + 2 || s.seq.load(std::memory_order_relaxed) != seq)
+                    continue;
+                std::snprintf(buf, sizeof(buf), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    sep, name, r->tid, start / 1000.0, dur / 1000.0);
+                out << buf;
+                sep = ",";
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+}
+
+#define CONSOLE_TRACE_CONCAT_(a, b) a##b
+#define CONSOLE_TRACE_CONCAT(a, b) CONSOLE_TRACE_CONCAT_(a, b)
+/* Record the time until the end of the enclosing scope. name must be a literal. */
+#define CONSOLE_TRACE_SCOPE(name) console::trace::Scope CONSOLE_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define CONSOLE_TRACE_THREAD_NAME(name) (console::trace::ring().thread_name = (name))
+#else
+#define CONSOLE_TRACE_SCOPE(name) ((void)0)
+#define CONSOLE_TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+/*
+ * Counts kept by the render thread, which does all drawing and wrapping.
+ * They are plain integers here and moved into the console's Counters once
+ * a frame by render_frame().
+ */
+struct RenderTally {
+    Uint64 glyphs { 0 };
+    Uint64 draw_calls { 0 };
+    Uint64 wraps { 0 };
+    Uint64 wrap_ns { 0 };
+    Uint64 lines_dropped { 0 };
+};
+static thread_local RenderTally tally;
+
+/*
+ * Heap use by subsystem, for Console_GetMemoryUsage(). An Account is a
+ * memory resource that counts what it passes on to its upstream; the
+ * containers belonging to a subsystem allocate from its account. The
+ * accounts are shared by all consoles.
+ */
+namespace memory {
+    /*
+     * Where the accounts get memory: operator new or a Console_Allocator.
+     * The hook is fixed by the first allocation, so no allocation can see
+     * it half written or be freed by another allocator.
+     */
+    class Upstream : public std::pmr::memory_resource {
+    public:
+        /* Returns false once anything has been allocated. */
+        bool set_hook(const Console_Allocator& allocator)
+        {
+            int expected = open;
+            if (!state.compare_exchange_strong(expected, setting, std::memory_order_acquire))
+                return false;
+            hook = allocator;
+            state.store(open, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        enum { open, setting, sealed };
+
+        void seal()
+        {
+            // Waits out a set_hook() in progress
+            int expected = open;
+            while (!state.compare_exchange_weak(expected, sealed, std::memory_order_acq_rel) && expected != sealed)
+                expected = open;
+        }
+
+        void* do_allocate(size_t n, size_t align) override
+        {
+            if (state.load(std::memory_order_acquire) != sealed)
+                seal();
+            if (!hook.alloc)
+                return ::operator new(n, std::align_val_t(align));
+            void* p = hook.alloc(hook.user, n, align);
+            if (!p)
+                throw std::bad_alloc();
+            return p;
+        }
+
+        void do_deallocate(void* p, size_t n, size_t align) override
+        {
+            if (!hook.free)
+                ::operator delete(p, n, std::align_val_t(align));
+            else
+                hook.free(hook.user, p, n, align);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        Console_Allocator hook {};
+        std::atomic<int> state { open };
+    };
+
+    static Upstream upstream;
+
+    class Account : public std::pmr::memory_resource {
+    public:
+        std::atomic<Sint64> bytes { 0 };
+        std::atomic<Sint64> allocations { 0 };
+        std::atomic<Uint64> total_allocations { 0 };
+
+    private:
+        void* do_allocate(size_t n, size_t align) override
+        {
+            void* p = upstream.allocate(n, align);
+            bytes += n;
+            allocations++;
+            total_allocations++;
+            return p;
+        }
+
+        void do_deallocate(void* p, size_t n, size_t align) override
+        {
+            upstream.deallocate(p, n, align);
+            bytes -= n;
+            allocations--;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+    };
+
+    static std::array<Account, CONSOLE_MEMORY_COUNT> accounts;
+
+    static const char* names[CONSOLE_MEMORY_COUNT] = {
+        "entry_text",
+        "wrap_lines",
+        "entries",
+        "history",
+        "api_queue",
+        "sdl_queue",
+        "font",
+        "frame",
+        "event_handlers",
+    };
+
+    Account* account(Console_MemorySubsystem s)
+    {
+        return &accounts[s];
+    }
+
+    /*
+     * Bump allocator for data that lasts at most a frame, such as the rows
+     * gathered by a clipboard copy. Deallocating does nothing; reset()
+     * rewinds to the start but keeps the blocks, so once they have grown to
+     * fit a frame no more are allocated.
+     */
+    class FrameArena : public std::pmr::memory_resource {
+    public:
+        FrameArena() = default;
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        ~FrameArena()
+        {
+            for (auto& b : blocks)
+                account(CONSOLE_MEMORY_FRAME)->deallocate(b.data, b.size, alignof(std::max_align_t));
+        }
+
+        void reset()
+        {
+            current = 0;
+            used = 0;
+        }
+
+    private:
+        static constexpr size_t block_size = 64 * 1024;
+
+        struct Block {
+            char* data;
+            size_t size;
+        };
+
+        void* do_allocate(size_t n, size_t align) override
+        {
+            for (; current < blocks.size(); ++current, used = 0) {
+                auto& b = blocks[current];
+                auto base = reinterpret_cast<uintptr_t>(b.data);
+                size_t start = ((base + used + align - 1) & ~(uintptr_t)(align - 1)) - base;
+                if (start + n <= b.size) {
+                    used = start + n;
+                    return b.data + start;
+                }
+            }
+            size_t size = std::max(block_size, n + align);
+            auto* data = static_cast<char*>(account(CONSOLE_MEMORY_FRAME)->allocate(size, alignof(std::max_align_t)));
+            blocks.push_back({ data, size });
+            current = blocks.size() - 1;
+            used = 0;
+            return do_allocate(n, align);
+        }
+
+        void do_deallocate(void*, size_t, size_t) override
+        {
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        std::vector<Block> blocks;
+        size_t current { 0 };
+        size_t used { 0 };
+    };
+}
+
 #if 0
 /*
  * std::wstring_convert and std::codecvt_utf8 are deprecated
@@ -166,22 +533,30 @@ static std::string to_utf8(const std::u32string& str)
 }
 #endif
 
-/* For consistency it might be better to stick with one utf8 library */
+/* Invalid code points, like surrogates, become U+FFFD. */
 static std::string to_utf8(const std::u32string& s)
 {
-    // Can be removed if confirmed iconv plays well with empty strings
-    if (s.empty())
-        return "";
-
-    // Not sure how safe this is.
-    const char* p = reinterpret_cast<const char*>(s.c_str());
-    // Need to make room for utf8 + terminating null, so can't use character count here..
-    char* conv_bytes = console::SDL_iconv_string("UTF-8", "UTF32", p, (s.length() + 1) * sizeof(char32_t));
-    if (!conv_bytes)
-        return "";
-
-    std::string result = conv_bytes;
-    console::SDL_free(conv_bytes);
+    std::string result;
+    result.reserve(s.length());
+    for (char32_t c : s) {
+        if (c >= 0xD800 && (c <= 0xDFFF || c > 0x10FFFF))
+            c = 0xFFFD;
+        if (c < 0x80) {
+            result += static_cast<char>(c);
+        } else if (c < 0x800) {
+            result += static_cast<char>(0xC0 | (c >> 6));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            result += static_cast<char>(0xE0 | (c >> 12));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            result += static_cast<char>(0xF0 | (c >> 18));
+            result += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
     return result;
 }
 
@@ -273,26 +648,15 @@ size_t utf8_strlen(const char* utf8str)
 
 static std::u32string from_utf8(const char* str)
 {
-    // Do we care about truncating long lines?
-    // 8k bytes, might be smart to reduce it to a memory page.
-    char32_t buf[2048];
-    constexpr int buf_siz = sizeof(buf) / sizeof(char32_t);
-    // char32_t* pbuf = buf;
-    size_t len = utf8_strlen(str);
-    // if (len > buf_siz - 1)
-    //     pbuf = new char32_t(len + 1);
+    std::u32string ret;
+    ret.reserve(utf8_strlen(str));
 
     int step = 0;
-    int idx = 0;
-    for (Uint32 codepoint = 1; codepoint && idx < buf_siz - 1; ++idx) {
-        // SDL_StepUTF8 isn't exported, but just in case.
-        codepoint = console::SDL_StepUTF8(str, &step, 4);
-        buf[idx] = codepoint;
+    // SDL_StepUTF8 isn't exported, but just in case.
+    for (Uint32 codepoint; (codepoint = console::SDL_StepUTF8(str, &step, 4));) {
+        ret += codepoint;
     }
-    // Terminate in case line was too long.
-    buf[idx] = U'\0';
-    // std::u32string ret = pbuf;
-    return buf;
+    return ret;
 }
 
 // For testing purposes, to be removed
@@ -384,7 +748,8 @@ struct InternalEventType {
         clicked,
         font_size_changed,
         range_changed,
-        value_changed
+        value_changed,
+        complete_input
     };
 };
 
@@ -416,10 +781,363 @@ struct Widget;
 SDL_Texture* create_text_texture(Widget&, const std::u32string&, const SDL_Color&);
 
 struct LogEntry;
+void wrap_entry(LogEntry& entry, int width, int advance);
 void make_logentry_lines(
     Widget& widget,
     LogEntry& entry,
-    std::u32string& text);
+    std::u32string_view text);
+
+/*
+ * Text attributes set by ANSI SGR sequences. A colour with alpha 0 means
+ * the console's default, so later colour changes apply to existing text.
+ */
+struct TextAttr {
+    enum Flags : Uint8 {
+        bold = 1 << 0,
+        underline = 1 << 1,
+        inverse = 1 << 2
+    };
+
+    SDL_Color fg {};
+    SDL_Color bg {};
+    Uint8 flags { 0 };
+
+    bool is_default() const
+    {
+        return fg.a == 0 && bg.a == 0 && flags == 0;
+    }
+
+    bool operator==(const TextAttr& o) const
+    {
+        return std::memcmp(&fg, &o.fg, sizeof(fg)) == 0 && std::memcmp(&bg, &o.bg, sizeof(bg)) == 0 && flags == o.flags;
+    }
+};
+
+/*
+ * An attribute applies from start up to the start of the next run, the
+ * last run to the end of the text. No runs means default attributes.
+ */
+struct AttrRun {
+    Uint32 start;
+    TextAttr attr;
+};
+using AttrRuns = std::vector<AttrRun>;
+
+/* Give [start, end) of a text of length len the attribute attr. */
+void assign_attr(AttrRuns& runs, size_t start, size_t end, size_t len, const TextAttr& attr)
+{
+    if (start >= end)
+        return;
+    if (runs.empty()) {
+        if (attr.is_default())
+            return;
+        runs.push_back({ 0, {} });
+    }
+
+    // Common case, appending
+    if (start >= runs.back().start && end >= len) {
+        if (runs.back().attr == attr)
+            return;
+        if (runs.back().start == start)
+            runs.pop_back();
+        if (runs.empty() || !(runs.back().attr == attr))
+            runs.push_back({ static_cast<Uint32>(start), attr });
+        return;
+    }
+
+    auto first = std::upper_bound(runs.begin(), runs.end(), start,
+        [](size_t i, const AttrRun& r) { return i < r.start; });
+    auto last = std::upper_bound(runs.begin(), runs.end(), end,
+        [](size_t i, const AttrRun& r) { return i < r.start; });
+    // Attribute resuming after the assigned range
+    TextAttr after = std::prev(last)->attr;
+    auto it = runs.erase(first, last);
+    it = runs.insert(it, { static_cast<Uint32>(start), attr });
+    if (end < len && (it + 1 == runs.end() || it[1].start != end))
+        runs.insert(it + 1, { static_cast<Uint32>(end), after });
+
+    // Drop runs that no longer change anything
+    auto out = runs.begin();
+    for (auto r = runs.begin() + 1; r != runs.end(); ++r) {
+        if (r->start == out->start)
+            *out = *r;
+        else if (!(r->attr == out->attr))
+            *++out = *r;
+    }
+    runs.erase(out + 1, runs.end());
+    if (runs.size() == 1 && runs[0].attr.is_default())
+        runs.clear();
+}
+
+/* Attribute of the character at index i. */
+const TextAttr& attr_at(const AttrRuns& runs, size_t i)
+{
+    static const TextAttr none {};
+    auto it = std::upper_bound(runs.begin(), runs.end(), i,
+        [](size_t i, const AttrRun& r) { return i < r.start; });
+    return (it == runs.begin()) ? none : std::prev(it)->attr;
+}
+
+/* xterm colour for a 256-colour palette index. */
+SDL_Color palette_color(int idx)
+{
+    static const SDL_Color base[16] = {
+        { 0, 0, 0, 255 }, { 205, 0, 0, 255 }, { 0, 205, 0, 255 }, { 205, 205, 0, 255 },
+        { 0, 0, 238, 255 }, { 205, 0, 205, 255 }, { 0, 205, 205, 255 }, { 229, 229, 229, 255 },
+        { 127, 127, 127, 255 }, { 255, 0, 0, 255 }, { 0, 255, 0, 255 }, { 255, 255, 0, 255 },
+        { 92, 92, 255, 255 }, { 255, 0, 255, 255 }, { 0, 255, 255, 255 }, { 255, 255, 255, 255 }
+    };
+    idx = std::clamp(idx, 0, 255);
+    if (idx < 16)
+        return base[idx];
+    if (idx < 232) {
+        static const Uint8 level[6] = { 0, 95, 135, 175, 215, 255 };
+        idx -= 16;
+        return { level[idx / 36], level[(idx / 6) % 6], level[idx % 6], 255 };
+    }
+    Uint8 gray = 8 + (idx - 232) * 10;
+    return { gray, gray, gray, 255 };
+}
+
+/* Apply the parameters of an SGR sequence ("ESC[...m") to attr. */
+void apply_sgr(std::u32string_view params, TextAttr& attr)
+{
+    int args[32];
+    int n = 0;
+    int v = 0;
+    for (size_t i = 0; i <= params.length() && n < 32; ++i) {
+        if (i == params.length() || params[i] == U';' || params[i] == U':') {
+            args[n++] = v;
+            v = 0;
+        } else if (params[i] >= U'0' && params[i] <= U'9') {
+            v = std::min(v * 10 + static_cast<int>(params[i] - U'0'), 0xFFFF);
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        int a = args[i];
+        if (a == 0) {
+            attr = {};
+        } else if (a == 1) {
+            attr.flags |= TextAttr::bold;
+        } else if (a == 4) {
+            attr.flags |= TextAttr::underline;
+        } else if (a == 7) {
+            attr.flags |= TextAttr::inverse;
+        } else if (a == 22) {
+            attr.flags &= ~TextAttr::bold;
+        } else if (a == 24) {
+            attr.flags &= ~TextAttr::underline;
+        } else if (a == 27) {
+            attr.flags &= ~TextAttr::inverse;
+        } else if (a >= 30 && a <= 37) {
+            attr.fg = palette_color(a - 30);
+        } else if (a >= 90 && a <= 97) {
+            attr.fg = palette_color(a - 90 + 8);
+        } else if (a >= 40 && a <= 47) {
+            attr.bg = palette_color(a - 40);
+        } else if (a >= 100 && a <= 107) {
+            attr.bg = palette_color(a - 100 + 8);
+        } else if (a == 39) {
+            attr.fg = {};
+        } else if (a == 49) {
+            attr.bg = {};
+        } else if (a == 38 || a == 48) {
+            SDL_Color c {};
+            if (i + 2 < n && args[i + 1] == 5) {
+                c = palette_color(args[i + 2]);
+                i += 2;
+            } else if (i + 4 < n && args[i + 1] == 2) {
+                c = { static_cast<Uint8>(std::min(args[i + 2], 255)),
+                    static_cast<Uint8>(std::min(args[i + 3], 255)),
+                    static_cast<Uint8>(std::min(args[i + 4], 255)), 255 };
+                i += 4;
+            } else {
+                break;
+            }
+            (a == 38 ? attr.fg : attr.bg) = c;
+        }
+    }
+}
+
+/*
+ * Parse the escape sequence starting at text[pos] (an ESC). Returns the
+ * index just past it. SGR sequences update attr; everything else is
+ * skipped. Control sequences that aren't terminated are dropped.
+ */
+size_t parse_escape(std::u32string_view text, size_t pos, TextAttr& attr)
+{
+    size_t i = pos + 1;
+    if (i >= text.length())
+        return i;
+
+    if (text[i] == U'[') {
+        // CSI: parameter and intermediate bytes, then a final byte
+        size_t params = ++i;
+        while (i < text.length() && (text[i] < 0x40 || text[i] > 0x7E))
+            ++i;
+        if (i == text.length())
+            return i;
+        if (text[i] == U'm')
+            apply_sgr(text.substr(params, i - params), attr);
+        return i + 1;
+    } else if (text[i] == U']') {
+        // OSC: terminated by BEL or ST (ESC \)
+        while (++i < text.length()) {
+            if (text[i] == U'\a')
+                return i + 1;
+            if (text[i] == U'\x1b')
+                return std::min(i + 2, text.length());
+        }
+        return i;
+    }
+    // Two character sequence
+    return i + 1;
+}
+
+/*
+ * Append src to dst, with '\r' moving pos back to the start of the current
+ * line so that the text following it overwrites. "\r\n" is a newline.
+ * pos is npos when writing at the end of dst.
+ */
+void append_overwriting(std::pmr::u32string& dst, std::u32string_view src, size_t& pos)
+{
+    auto line_start = dst.rfind(U'\n');
+    line_start = (line_start == std::u32string::npos) ? 0 : line_start + 1;
+    if (pos > dst.length())
+        pos = dst.length();
+
+    for (size_t i = 0; i < src.length(); ++i) {
+        auto ch = src[i];
+        if (ch == U'\r') {
+            if (i + 1 < src.length() && src[i + 1] == U'\n')
+                continue;
+            pos = line_start;
+        } else if (ch == U'\n') {
+            dst += ch;
+            pos = line_start = dst.length();
+        } else if (pos < dst.length()) {
+            dst[pos++] = ch;
+        } else {
+            dst += ch;
+            pos++;
+        }
+    }
+
+    if (pos == dst.length())
+        pos = std::u32string::npos;
+}
+
+/* Whether a character is one that text may be wrapped at or after. */
+inline bool is_break(char32_t ch)
+{
+    return ch == U' ' || ch == U'\t' || ch == U'\n' || ch == U'\r';
+}
+
+/* Bit i is set if p[i] is_break(), for the 8 characters at p. */
+inline unsigned scan_breaks8(const char32_t* p)
+{
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i space = _mm_set1_epi32(' ');
+    const __m128i tab = _mm_set1_epi32('\t');
+    const __m128i lf = _mm_set1_epi32('\n');
+    const __m128i cr = _mm_set1_epi32('\r');
+    unsigned mask = 0;
+    for (int half = 0; half < 2; ++half) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + half * 4));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(v, space), _mm_cmpeq_epi32(v, tab)),
+            _mm_or_si128(_mm_cmpeq_epi32(v, lf), _mm_cmpeq_epi32(v, cr)));
+        mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m))) << (half * 4);
+    }
+    return mask;
+#elif defined(__ARM_NEON)
+    const uint32_t lane_bits[4] = { 1, 2, 4, 8 };
+    const uint32x4_t lanes = vld1q_u32(lane_bits);
+    unsigned mask = 0;
+    for (int half = 0; half < 2; ++half) {
+        uint32x4_t v = vld1q_u32(reinterpret_cast<const uint32_t*>(p + half * 4));
+        uint32x4_t m = vorrq_u32(vorrq_u32(vceqq_u32(v, vdupq_n_u32(' ')), vceqq_u32(v, vdupq_n_u32('\t'))),
+            vorrq_u32(vceqq_u32(v, vdupq_n_u32('\n')), vceqq_u32(v, vdupq_n_u32('\r'))));
+        uint32x4_t bits = vandq_u32(m, lanes);
+        uint32x2_t sum = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+        mask |= vget_lane_u32(vpadd_u32(sum, sum), 0) << (half * 4);
+    }
+    return mask;
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < 8; ++i)
+        mask |= unsigned(is_break(p[i])) << i;
+    return mask;
+#endif
+}
+
+/*
+ * Finds the lines of wrapped text one at a time by walking the text's
+ * break index (LogEntry::breaks). Between two breaks there is only text,
+ * where a line has to be cut once it reaches the column count; that's
+ * found with arithmetic, so a long run costs a step per line. The walk's
+ * position is a plain struct, so it can be saved and resumed.
+ */
+struct LineBreaker {
+    static constexpr Uint32 hard_break = 0x80000000u;
+
+    struct Position {
+        size_t start { 0 }; // of the line being filled
+        size_t delim { 0 }; // last whitespace character for wrapping on word boundaries, 0 if none
+        size_t run { 0 }; // first character after the last break
+        size_t next_break { 0 }; // index into breaks, past their end once done
+    };
+
+    std::u32string_view text;
+    const Uint32* breaks;
+    size_t nbreaks;
+    size_t columns; // a character is wrapped once the line would reach this
+    Position pos {};
+
+    /* Set start and end to the next line's, returning false past the last. */
+    bool next(size_t& start, size_t& end)
+    {
+        while (pos.next_break <= nbreaks) {
+            const bool last = pos.next_break == nbreaks;
+            const Uint32 b = last ? 0 : breaks[pos.next_break];
+            const size_t at_break = last ? text.length() : (b & ~hard_break);
+
+            // Cut the text before the break if it doesn't fit
+            size_t at = std::max(pos.run, pos.start + columns - 1);
+            if (at < at_break) {
+                start = pos.start;
+                // wrap at last whitespace, else at last character
+                end = pos.delim ? pos.delim + 1 : at + 1;
+                pos.start = end;
+                pos.delim = 0;
+                pos.run = at + 1;
+                return true;
+            }
+
+            pos.next_break++;
+            if (last) {
+                //  Handle any remaining text
+                start = pos.start;
+                end = std::u32string::npos;
+                return text.length() > start;
+            }
+            pos.run = at_break + 1;
+            if (b & hard_break) {
+                // Not including the new line character
+                start = pos.start;
+                end = at_break;
+                pos.start = at_break + 1;
+                pos.delim = 0;
+                // Don't attempt to add an empty segment
+                if (end > start)
+                    return true;
+            } else {
+                pos.delim = at_break;
+            }
+        }
+        return false;
+    }
+};
 
 struct WrappedLine {
     std::u32string_view text; // text of line segment
@@ -440,15 +1158,35 @@ struct WrappedLine {
 
     WrappedLine(const WrappedLine&) = delete;
     WrappedLine& operator=(const WrappedLine&) = delete;
+    WrappedLine(WrappedLine&&) = default;
+    WrappedLine& operator=(WrappedLine&&) = default;
 };
 
-using LogEntryLines = std::deque<WrappedLine>;
+using LogEntryLines = std::pmr::vector<WrappedLine>;
 struct LogEntry {
     EntryType type;
     // Original text.
-    std::u32string text;
+    std::pmr::u32string text { memory::account(CONSOLE_MEMORY_ENTRY_TEXT) };
     SDL_Rect rect;
     size_t size { 0 }; // total # of lines
+    Console_LineId id { 0 }; // set for lines added via the API
+    bool removed { false }; // removed through the API, awaiting eviction
+    // Cleared where a giant entry would be a problem, as for the prompt,
+    // whose cursor walks every line. See chunk_threshold.
+    bool chunkable { true };
+    // Where text written after a '\r' lands, npos = end of text.
+    size_t write_pos { std::u32string::npos };
+    AttrRuns attrs; // attributes from escape sequences in the text
+    TextAttr attr_state; // attributes in effect for appended text
+    size_t accounted_bytes { 0 }; // memory_usage() when last counted in the scrollback
+    // Offsets of whitespace in the text, and of '\n' and '\r' with
+    // hard_break set. See index_breaks().
+    std::pmr::vector<Uint32> breaks { memory::account(CONSOLE_MEMORY_WRAP_LINES) };
+    static constexpr Uint32 hard_break = LineBreaker::hard_break;
+    // Entries longer than this are wrapped chunk_lines lines at a time, as
+    // they're looked at; see wrap_chunked().
+    static constexpr size_t chunk_threshold = 1 << 16;
+    static constexpr size_t chunk_lines = 512;
 
     LogEntry() {};
 
@@ -456,9 +1194,123 @@ struct LogEntry {
     {
     }
 
-    LogEntry(EntryType type, const std::u32string& text)
+    LogEntry(EntryType type, std::u32string_view text)
         : type(type)
-        , text(text) {};
+        , text(text, memory::account(CONSOLE_MEMORY_ENTRY_TEXT))
+    {
+        index_breaks();
+    }
+
+    /*
+     * Find where the text may be wrapped. That doesn't depend on the width,
+     * so it's done once each time the text changes, and wrap_entry() walks
+     * the result. Must be called after any change to the text. Text past
+     * 2^31 characters isn't indexed and only wraps at the width.
+     */
+    void index_breaks()
+    {
+        const size_t n = std::min<size_t>(text.length(), hard_break);
+        const size_t blocks = n & ~size_t(7);
+        const char32_t* p = text.data();
+        auto add = [&](size_t i) {
+            bool hard = p[i] == U'\n' || p[i] == U'\r';
+            breaks.push_back(static_cast<Uint32>(i) | (hard ? hard_break : 0));
+        };
+
+        // Counted first so the index is allocated once, at its size
+        size_t count = 0;
+        for (size_t i = 0; i < blocks; i += 8)
+            count += std::popcount(scan_breaks8(p + i));
+        for (size_t i = blocks; i < n; ++i)
+            count += is_break(p[i]);
+        breaks.clear();
+        breaks.reserve(count);
+
+        for (size_t i = 0; i < blocks; i += 8) {
+            for (unsigned mask = scan_breaks8(p + i); mask; mask &= mask - 1)
+                add(i + std::countr_zero(mask));
+        }
+        for (size_t i = blocks; i < n; ++i) {
+            if (is_break(p[i]))
+                add(i);
+        }
+        columns_ = cached_columns_ = -1;
+        checkpoints.clear();
+    }
+
+    bool chunked() const
+    {
+        return !checkpoints.empty();
+    }
+
+    /*
+     * Count the lines for columns without keeping them. Where every
+     * chunk_lines-th line starts is saved, and line() wraps a chunk from
+     * there when one of its lines is wanted. The two chunks used most
+     * recently are kept, enough for any view shorter than a chunk.
+     */
+    void wrap_chunked(size_t columns)
+    {
+        if (chunked() && static_cast<int>(columns) == columns_)
+            return;
+        checkpoints.clear();
+        LineBreaker walk { text, breaks.data(), breaks.size(), columns };
+        size = 0;
+        for (size_t start, end;; ++size) {
+            if (size % chunk_lines == 0)
+                checkpoints.push_back(walk.pos);
+            if (!walk.next(start, end))
+                break;
+        }
+        if (size && size % chunk_lines == 0)
+            checkpoints.pop_back();
+        lines_.clear();
+        cached_lines_.clear();
+        chunk_ = cached_chunk_ = no_chunk;
+        columns_ = static_cast<int>(columns);
+        cached_columns_ = -1;
+    }
+
+    /* Line i, counting from the first. Wraps its chunk if need be. */
+    WrappedLine& line(size_t i)
+    {
+        if (!chunked())
+            return lines_[i];
+        Uint32 chunk = static_cast<Uint32>(i / chunk_lines);
+        if (chunk != chunk_) {
+            std::swap(lines_, cached_lines_);
+            std::swap(chunk_, cached_chunk_);
+            if (chunk != chunk_)
+                wrap_chunk(chunk);
+        }
+        return lines_[i - size_t(chunk) * chunk_lines];
+    }
+
+    /*
+     * Make the lines those for columns, returning true if they already were
+     * or were cached. Otherwise the current lines are cached, if valid, and
+     * the caller is left to wrap into empty ones. The two most recent
+     * layouts are kept, so toggling between sizes doesn't rewrap.
+     */
+    bool use_layout(int columns)
+    {
+        if (columns == columns_)
+            return true;
+        if (columns == cached_columns_) {
+            std::swap(lines_, cached_lines_);
+            std::swap(columns_, cached_columns_);
+            size = lines_.size();
+            return true;
+        }
+        if (columns_ != -1) {
+            std::swap(lines_, cached_lines_);
+            cached_columns_ = columns_;
+        }
+        lines_.clear();
+        size = 0;
+        columns_ = columns;
+        return false;
+    }
 
     auto& add_line(std::u32string_view segment, size_t start_index, size_t end_index)
     {
@@ -469,6 +1321,8 @@ struct LogEntry {
     {
         size = 0;
         lines_.clear();
+        columns_ = -1;
+        checkpoints.clear();
     }
 
     LogEntryLines& lines()
@@ -476,14 +1330,163 @@ struct LogEntry {
         return lines_;
     }
 
+    /* Bytes held by the entry, including its allocations. */
+    size_t memory_usage() const
+    {
+        return sizeof(LogEntry) + text.capacity() * sizeof(char32_t)
+            + (lines_.capacity() + cached_lines_.capacity()) * sizeof(WrappedLine)
+            + attrs.capacity() * sizeof(AttrRun) + breaks.capacity() * sizeof(Uint32)
+            + checkpoints.capacity() * sizeof(LineBreaker::Position);
+    }
+
     LogEntry(const LogEntry&) = delete;
     LogEntry& operator=(const LogEntry&) = delete;
 
-private:
-    LogEntryLines lines_;
-};
-
-struct Glyph {
+    // Moving may relocate short strings, so line views are re-pointed.
+    LogEntry(LogEntry&& other) noexcept
+        : type(other.type)
+        , text(std::move(other.text))
+        , rect(other.rect)
+        , size(other.size)
+        , id(other.id)
+        , removed(other.removed)
+        , chunkable(other.chunkable)
+        , write_pos(other.write_pos)
+        , attrs(std::move(other.attrs))
+        , attr_state(other.attr_state)
+        , accounted_bytes(other.accounted_bytes)
+        , breaks(std::move(other.breaks))
+        , lines_(std::move(other.lines_))
+        , cached_lines_(std::move(other.cached_lines_))
+        , columns_(other.columns_)
+        , cached_columns_(other.cached_columns_)
+        , checkpoints(std::move(other.checkpoints))
+        , chunk_(other.chunk_)
+        , cached_chunk_(other.cached_chunk_)
+    {
+        rebase_lines();
+    }
+
+    LogEntry& operator=(LogEntry&& other) noexcept
+    {
+        if (this != &other) {
+            type = other.type;
+            text = std::move(other.text);
+            rect = other.rect;
+            size = other.size;
+            id = other.id;
+            removed = other.removed;
+            chunkable = other.chunkable;
+            write_pos = other.write_pos;
+            attrs = std::move(other.attrs);
+            attr_state = other.attr_state;
+            accounted_bytes = other.accounted_bytes;
+            breaks = std::move(other.breaks);
+            lines_ = std::move(other.lines_);
+            cached_lines_ = std::move(other.cached_lines_);
+            columns_ = other.columns_;
+            cached_columns_ = other.cached_columns_;
+            checkpoints = std::move(other.checkpoints);
+            chunk_ = other.chunk_;
+            cached_chunk_ = other.cached_chunk_;
+            rebase_lines();
+        }
+        return *this;
+    }
+
+private:
+    void rebase_lines()
+    {
+        for (auto* lines : { &lines_, &cached_lines_ }) {
+            for (auto& line : *lines)
+                line.text = std::u32string_view(text).substr(line.start_index, line.text.length());
+        }
+    }
+
+    void wrap_chunk(Uint32 chunk)
+    {
+        LineBreaker walk { text, breaks.data(), breaks.size(), static_cast<size_t>(columns_), checkpoints[chunk] };
+        lines_.clear();
+        size_t first = size_t(chunk) * chunk_lines;
+        size_t start, end;
+        for (size_t i = first; i < std::min(size, first + chunk_lines) && walk.next(start, end); ++i)
+            lines_.emplace_back(std::u32string_view(text).substr(start, end - start), i, start, end);
+        chunk_ = chunk;
+    }
+
+    // Layouts for the current and previous column counts. Chunked entries
+    // keep two of their chunks here instead.
+    LogEntryLines lines_ { memory::account(CONSOLE_MEMORY_WRAP_LINES) };
+    LogEntryLines cached_lines_ { memory::account(CONSOLE_MEMORY_WRAP_LINES) };
+    int columns_ { -1 }; // what lines_ were wrapped for, -1 if stale
+    int cached_columns_ { -1 };
+    // Where each chunk's walk starts, for chunked entries
+    std::pmr::vector<LineBreaker::Position> checkpoints { memory::account(CONSOLE_MEMORY_WRAP_LINES) };
+    Uint32 chunk_ { no_chunk }; // chunk in lines_
+    Uint32 cached_chunk_ { no_chunk }; // chunk in cached_lines_
+    static constexpr Uint32 no_chunk = UINT32_MAX;
+};
+
+/* Write plain text to an entry with its current attributes. */
+void write_entry_text(LogEntry& entry, std::u32string_view text, bool overwrite_on_cr)
+{
+    if (text.empty())
+        return;
+
+    if (!overwrite_on_cr) {
+        size_t start = entry.text.length();
+        entry.text += text;
+        assign_attr(entry.attrs, start, entry.text.length(), entry.text.length(), entry.attr_state);
+        return;
+    }
+
+    // Write the text between control characters one piece at a time,
+    // so that each piece lands in a single span.
+    size_t i = 0;
+    while (i < text.length()) {
+        auto ctl = text.find_first_of(U"\r\n", i);
+        auto piece = text.substr(i, (ctl == std::u32string_view::npos) ? ctl : ctl - i);
+        if (!piece.empty()) {
+            size_t start = (entry.write_pos == std::u32string::npos) ? entry.text.length() : entry.write_pos;
+            append_overwriting(entry.text, piece, entry.write_pos);
+            assign_attr(entry.attrs, start, start + piece.length(), entry.text.length(), entry.attr_state);
+        }
+        if (ctl == std::u32string_view::npos)
+            break;
+
+        size_t n = (text[ctl] == U'\r' && ctl + 1 < text.length() && text[ctl + 1] == U'\n') ? 2 : 1;
+        append_overwriting(entry.text, text.substr(ctl, n), entry.write_pos);
+        i = ctl + n;
+    }
+}
+
+/*
+ * Append text to an entry. Escape sequences are stripped here, once,
+ * with SGR attributes kept as runs beside the text. Touches nothing but
+ * the entry, so output can be prepared on the thread that adds it.
+ */
+void append_entry_text(LogEntry& entry, std::u32string_view text, bool overwrite_on_cr)
+{
+    size_t i = 0;
+    while (i < text.length()) {
+        auto esc = text.find(U'\x1b', i);
+        write_entry_text(entry, text.substr(i, (esc == std::u32string_view::npos) ? esc : esc - i), overwrite_on_cr);
+        if (esc == std::u32string_view::npos)
+            break;
+        i = parse_escape(text, esc, entry.attr_state);
+    }
+    entry.index_breaks();
+}
+
+/* An output entry ready to be added to a LogScreen, which only wraps it. */
+LogEntry make_output_entry(std::u32string_view text, bool overwrite_on_cr)
+{
+    LogEntry entry(EntryType::output, U"");
+    append_entry_text(entry, text, overwrite_on_cr);
+    return entry;
+}
+
+struct Glyph {
     SDL_Rect rect;
 };
 struct FontLoader;
@@ -491,19 +1494,25 @@ struct FontLoader;
 struct Font {
     FontLoader& loader;
     SDL_Texture* texture;
-    std::vector<Glyph> glyphs;
+    std::pmr::vector<Glyph> glyphs { memory::account(CONSOLE_MEMORY_FONT) };
     int char_width;
     int line_height;
     float scale { 1 };
-    int line_space { 4 };
+    static constexpr int default_line_space = 4;
+    int line_space { default_line_space };
     int orig_char_width;
     int orig_line_height;
     int scale_step { 2 };
+    // One bit per pixel of each glyph, a Uint32 per row. Bit 0 is the
+    // leftmost pixel. Empty when the sheet couldn't be read.
+    std::pmr::vector<Uint32> masks { memory::account(CONSOLE_MEMORY_FONT) };
+    int mask_w { 0 };
+    int mask_h { 0 };
 
     Font(FontLoader& loader, SDL_Texture* texture, std::vector<Glyph>& glyphs, int char_width, int line_height)
         : loader(loader)
         , texture(texture)
-        , glyphs(glyphs)
+        , glyphs(glyphs.begin(), glyphs.end(), memory::account(CONSOLE_MEMORY_FONT))
         , char_width(char_width)
         , line_height(line_height)
     {
@@ -520,17 +1529,23 @@ struct Font {
     void render(SDL_Renderer* renderer, const std::u32string_view& text, int x, int y)
     {
         for (auto& ch : text) {
-            char32_t index;
-            if (ch <= 127)
-                index = ch;
-            else {
-                index = unicode_glyph_index(ch);
-            }
-            Glyph& g = glyphs[index];
+            Glyph& g = glyph(ch);
             SDL_Rect dst = { x, y, static_cast<int>(g.rect.w * scale), static_cast<int>(g.rect.h * scale) };
             x += g.rect.w * scale;
             console::SDL_RenderCopy(renderer, texture, &g.rect, &dst);
         }
+        tally.glyphs += text.length();
+        tally.draw_calls += text.length();
+    }
+
+    Glyph& glyph(const char32_t ch)
+    {
+        return glyphs[glyph_index(ch)];
+    }
+
+    size_t glyph_index(const char32_t ch)
+    {
+        return (ch <= 127) ? ch : unicode_glyph_index(ch);
     }
 
     // Get the surface size of a text.
@@ -563,12 +1578,15 @@ struct Font {
     Font(Font&& other) noexcept
         : loader(other.loader)
         , texture(other.texture)
-        , glyphs(other.glyphs)
+        , glyphs(std::move(other.glyphs))
         , char_width(other.char_width)
         , line_height(other.line_height)
         , scale(other.scale)
         , orig_char_width(other.orig_char_width)
         , orig_line_height(other.orig_line_height)
+        , masks(std::move(other.masks))
+        , mask_w(other.mask_w)
+        , mask_h(other.mask_h)
     {
     }
 
@@ -582,6 +1600,9 @@ struct Font {
             scale = other.scale;
             orig_char_width = other.char_width;
             orig_line_height = other.line_height;
+            masks = std::move(other.masks);
+            mask_w = other.mask_w;
+            mask_h = other.mask_h;
         }
         return *this;
     }
@@ -598,6 +1619,603 @@ private:
     }
 };
 
+/*
+ * Collects a frame's glyph copies and background rects grouped by colour,
+ * so the texture colour mod and draw colour change once per colour rather
+ * than per run. Buckets are kept between frames to reuse their storage.
+ */
+struct GlyphBatch {
+    struct Quad {
+        SDL_Rect src;
+        SDL_Rect dst;
+    };
+
+    template <typename T>
+    struct Bucket {
+        SDL_Color color;
+        std::vector<T> items;
+    };
+
+    void add_text(Font& font, std::u32string_view text, int x, int y, const SDL_Color& color)
+    {
+        if (text.empty())
+            return;
+        auto& quads = bucket(glyphs, color);
+        for (auto ch : text) {
+            Glyph& g = font.glyph(ch);
+            SDL_Rect dst = { x, y, static_cast<int>(g.rect.w * font.scale), static_cast<int>(g.rect.h * font.scale) };
+            x += g.rect.w * font.scale;
+            quads.push_back({ g.rect, dst });
+        }
+    }
+
+    void add_rect(const SDL_Rect& rect, const SDL_Color& color)
+    {
+        bucket(rects, color).push_back(rect);
+    }
+
+    /* Draw backgrounds, then glyphs, and empty the batch. */
+    void flush(SDL_Renderer* renderer, SDL_Texture* texture)
+    {
+        for (auto& b : rects) {
+            if (b.items.empty())
+                continue;
+            set_draw_color(renderer, b.color);
+            for (auto& r : b.items)
+                console::SDL_RenderFillRect(renderer, &r);
+            tally.draw_calls += b.items.size();
+            b.items.clear();
+        }
+
+        for (auto& b : glyphs) {
+            if (b.items.empty())
+                continue;
+            console::SDL_SetTextureColorMod(texture, b.color.r, b.color.g, b.color.b);
+            for (auto& q : b.items)
+                console::SDL_RenderCopy(renderer, texture, &q.src, &q.dst);
+            tally.glyphs += b.items.size();
+            tally.draw_calls += b.items.size();
+            b.items.clear();
+        }
+        console::SDL_SetTextureColorMod(texture, 255, 255, 255);
+    }
+
+private:
+    template <typename T>
+    std::vector<T>& bucket(std::vector<Bucket<T>>& buckets, const SDL_Color& c)
+    {
+        for (auto& b : buckets) {
+            if (b.color.r == c.r && b.color.g == c.g && b.color.b == c.b && b.color.a == c.a)
+                return b.items;
+        }
+        // Colours seen once shouldn't pile up over a long session
+        for (auto& b : buckets) {
+            if (b.items.empty()) {
+                b.color = c;
+                return b.items;
+            }
+        }
+        buckets.push_back({ c, {} });
+        return buckets.back().items;
+    }
+
+    std::vector<Bucket<Quad>> glyphs;
+    std::vector<Bucket<SDL_Rect>> rects;
+};
+
+/*
+ * Small fixed-size pool of worker threads. Threads are only started on the
+ * first submit(), so hosts that never use it don't pay for them.
+ */
+class ThreadPool {
+public:
+    using Job = std::function<void()>;
+
+    ThreadPool(size_t size)
+        : size(size)
+    {
+    }
+
+    ~ThreadPool()
+    {
+        shutdown();
+    }
+
+    void submit(Job job)
+    {
+        {
+            std::scoped_lock lock(mutex);
+            if (stopping)
+                return;
+            if (threads.empty())
+                start();
+            jobs.push(std::move(job));
+        }
+        cv.notify_one();
+    }
+
+    /*
+     * Run fn(i) for every i in [0, n) on the pool and the calling thread,
+     * returning once all calls have. Indices are handed out one at a time,
+     * so uneven items balance out. Not to be called from a pool thread.
+     */
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn)
+    {
+        if (n <= 1 || size == 0) {
+            for (size_t i = 0; i < n; ++i)
+                fn(i);
+            return;
+        }
+
+        // Helpers may only get to run after the caller has finished
+        // everything, so what they touch is shared rather than on this stack
+        struct State {
+            std::atomic<size_t> next { 0 };
+            std::atomic<size_t> done { 0 };
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+        auto state = std::make_shared<State>();
+        auto work = [state, &fn, n] {
+            for (size_t i; (i = state->next.fetch_add(1)) < n;) {
+                fn(i);
+                if (state->done.fetch_add(1) + 1 == n) {
+                    std::scoped_lock lock(state->mutex);
+                    state->cv.notify_all();
+                }
+            }
+        };
+
+        for (size_t i = 0; i < std::min(size, n - 1); ++i)
+            submit(work);
+        work();
+
+        std::unique_lock lock(state->mutex);
+        state->cv.wait(lock, [&] { return state->done == n; });
+    }
+
+    size_t threads_count() const
+    {
+        return size;
+    }
+
+    /* One less than the cores, as the caller of parallel_for() helps. */
+    static size_t default_size()
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 1 ? std::min(n - 1, 7u) : 0;
+    }
+
+    /* Drops queued jobs and waits for running ones to return. */
+    void shutdown()
+    {
+        {
+            std::scoped_lock lock(mutex);
+            stopping = true;
+            jobs = {};
+        }
+        cv.notify_all();
+        for (auto& t : threads) {
+            if (t.joinable())
+                t.join();
+        }
+        threads.clear();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    void start()
+    {
+        for (size_t i = 0; i < size; ++i) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+    void run()
+    {
+        CONSOLE_TRACE_THREAD_NAME("console worker");
+        while (1) {
+            Job job;
+            {
+                std::unique_lock lock(mutex);
+                cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+    size_t size;
+    bool stopping { false };
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::queue<Job> jobs;
+    std::vector<std::thread> threads;
+};
+
+/*
+ * Destroys what it is handed on a low priority thread of its own, so
+ * freeing a big scrollback doesn't stall a frame. Like ThreadPool, the
+ * thread is only started on the first dispose(). Whatever is disposed of
+ * must not refer to anything the caller goes on to change.
+ */
+class Reclaimer {
+public:
+    Reclaimer() = default;
+
+    ~Reclaimer()
+    {
+        {
+            std::scoped_lock lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    template <typename T>
+    void dispose(T&& garbage)
+    {
+        auto holder = std::make_unique<Holder<std::decay_t<T>>>(std::forward<T>(garbage));
+        {
+            std::scoped_lock lock(mutex);
+            if (!thread.joinable())
+                thread = std::thread([this] { run(); });
+            queue.push_back(std::move(holder));
+        }
+        cv.notify_all();
+    }
+
+    /* Waits until everything disposed of so far has been freed. */
+    void flush()
+    {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this] { return queue.empty() && !busy; });
+    }
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+private:
+    struct Garbage {
+        virtual ~Garbage() = default;
+    };
+
+    template <typename T>
+    struct Holder : Garbage {
+        explicit Holder(T&& value)
+            : value(std::move(value))
+        {
+        }
+        T value;
+    };
+
+    void run()
+    {
+        CONSOLE_TRACE_THREAD_NAME("console reclaimer");
+        console::SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+        std::unique_lock lock(mutex);
+        while (1) {
+            cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            // Drain before stopping, what's queued is still owned here
+            if (queue.empty())
+                return;
+            auto batch = std::move(queue);
+            queue.clear();
+            busy = true;
+            lock.unlock();
+            {
+                CONSOLE_TRACE_SCOPE("reclaim");
+                batch.clear();
+            }
+            lock.lock();
+            busy = false;
+            cv.notify_all();
+        }
+    }
+
+    bool stopping { false };
+    bool busy { false };
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<Garbage>> queue;
+    std::thread thread;
+};
+
+/*
+ * Text drawn on the CPU for software renderers, where each glyph copy goes
+ * through SDL's generic blitter. Cells are expanded from the font's 1-bit
+ * glyph masks into a pixel buffer and uploaded to a streaming texture with
+ * one SDL_UpdateTexture covering the rows that changed since last frame.
+ * Cells without a background stay transparent so the selection drawn
+ * beneath still shows. Large updates are split into bands of rows that
+ * are filled in parallel, each band writing only its own rows of pixels.
+ */
+struct SoftRaster {
+    ~SoftRaster()
+    {
+        if (texture)
+            console::SDL_DestroyTexture(texture);
+    }
+
+    /*
+     * Start a frame of cols x rows cells, all blank. A change of size or
+     * font scale redraws everything. Returns false if there's no texture
+     * or usable glyph masks, in which case the caller draws as usual.
+     */
+    bool begin(SDL_Renderer* renderer, Font& font, int cols, int rows)
+    {
+        if (font.masks.empty() || font.char_width > 64 || cols <= 0 || rows <= 0)
+            return false;
+
+        if (&font != font_ || font.char_width != cw || font.line_height != lh) {
+            cw = font.char_width;
+            lh = font.line_height;
+            scale_masks(font);
+            ncols = 0;
+        }
+
+        if (cols != ncols || rows != nrows)
+            resize(renderer, cols, rows);
+
+        back.assign(front.size(), {});
+        for (auto& c : back)
+            c.glyph = U' ';
+        return texture != nullptr;
+    }
+
+    /* Put text at a cell with resolved colours. A bg alpha of 0 is transparent. */
+    void put(int row, int col, std::u32string_view text, const SDL_Color& fg, const SDL_Color& bg, bool underline)
+    {
+        if (row < 0 || row >= nrows || col >= ncols)
+            return;
+        Cell* dst = &back[static_cast<size_t>(row) * ncols];
+        const Uint32 f = pack(fg);
+        const Uint32 b = bg.a ? pack(bg) : 0;
+        tally.glyphs += text.length();
+        for (size_t i = 0; i < text.length() && col < ncols; ++i, ++col) {
+            if (col < 0)
+                continue;
+            dst[col] = { static_cast<Uint32>(font_->glyph_index(text[i])), f, b, underline };
+        }
+    }
+
+    /* Rasterize changed rows, upload them, and copy the texture to x, y. */
+    void present(SDL_Renderer* renderer, int x, int y)
+    {
+        // More bands than threads so a slow band doesn't hold up the rest
+        const int nbands = static_cast<int>(pool.threads_count() + 1) * 2;
+        const int band_rows = std::max(1, (nrows + nbands - 1) / nbands);
+        dirty_rows.assign(nrows, false);
+        dirty_bands.clear();
+        int first = nrows, last = -1;
+        size_t dirty_cells = 0;
+        for (int r = 0; r < nrows; ++r) {
+            size_t off = static_cast<size_t>(r) * ncols;
+            if (std::memcmp(&back[off], &front[off], ncols * sizeof(Cell)) == 0)
+                continue;
+            std::memcpy(&front[off], &back[off], ncols * sizeof(Cell));
+            dirty_rows[r] = true;
+            dirty_cells += ncols;
+            if (dirty_bands.empty() || dirty_bands.back() != r / band_rows)
+                dirty_bands.push_back(r / band_rows);
+            first = std::min(first, r);
+            last = r;
+        }
+
+        auto raster_band = [&](size_t i) {
+            const int begin = dirty_bands[i] * band_rows;
+            const int end = std::min(nrows, begin + band_rows);
+            for (int r = begin; r < end; ++r) {
+                if (dirty_rows[r])
+                    raster_row(r);
+            }
+        };
+        // Waking the pool costs more than a line or two of typing
+        if (dirty_cells >= parallel_min_cells) {
+            pool.parallel_for(dirty_bands.size(), raster_band);
+        } else {
+            for (size_t i = 0; i < dirty_bands.size(); ++i)
+                raster_band(i);
+        }
+
+        const int pitch = ncols * cw;
+        if (last >= 0) {
+            SDL_Rect span = { 0, first * lh, pitch, (last - first + 1) * lh };
+            console::SDL_UpdateTexture(texture, &span, &pixels[static_cast<size_t>(span.y) * pitch],
+                pitch * sizeof(Uint32));
+            tally.draw_calls++;
+        }
+
+        SDL_Rect dst = { x, y, pitch, nrows * lh };
+        console::SDL_RenderCopy(renderer, texture, nullptr, &dst);
+        tally.draw_calls++;
+    }
+
+    /*
+     * Cells per second drawn on renderer, counting what present() does for
+     * a full grid of changed cells: filling on the pool, the upload and the
+     * copy. Glyphs are glyph_h rows of cells cw x lh, with made up masks.
+     * Returns 0 if the renderer can't do it.
+     */
+    static double probe_rate(SDL_Renderer* renderer, ThreadPool& pool, int cw, int glyph_h, int lh)
+    {
+        if (cw <= 0 || cw > 64 || lh <= 0)
+            return 0;
+        int w = 0, h = 0;
+        console::SDL_GetRendererOutputSize(renderer, &w, &h);
+        const int cols = std::max(1, w / cw);
+        const int rows = std::max(1, h / lh);
+
+        SoftRaster probe(pool);
+        probe.cw = cw;
+        probe.lh = lh;
+        probe.glyph_h = std::min(glyph_h, lh);
+        probe.scaled.resize(256 * probe.glyph_h);
+        for (size_t i = 0; i < probe.scaled.size(); ++i)
+            probe.scaled[i] = (i * 0x9E3779B97F4A7C15ull) >> 17;
+        probe.resize(renderer, cols, rows);
+        if (!probe.texture)
+            return 0;
+        probe.back.resize(probe.front.size());
+
+        // Every cell changes every frame, with colours varying along a row
+        auto frame = [&](int n) {
+            for (size_t i = 0; i < probe.back.size(); ++i)
+                probe.back[i] = { static_cast<Uint32>((i + n) % 95 + 33), 0xFF000000u | Uint32(i * 2654435761u), 0, 0 };
+            probe.present(renderer, 0, 0);
+        };
+        auto finish = [&] {
+            Uint32 px;
+            SDL_Rect one = { 0, 0, 1, 1 };
+            console::SDL_RenderReadPixels(renderer, &one, SDL_PIXELFORMAT_ARGB8888, &px, sizeof(px));
+        };
+
+        constexpr int frames = 20;
+        frame(0); // warm up
+        finish();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 1; i <= frames; ++i)
+            frame(i);
+        finish();
+        std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+        console::SDL_RenderClear(renderer);
+        return secs.count() > 0 ? static_cast<double>(frames) * cols * rows / secs.count() : 0;
+    }
+
+    explicit SoftRaster(ThreadPool& pool)
+        : pool(pool)
+    {
+    }
+    SoftRaster(const SoftRaster&) = delete;
+    SoftRaster& operator=(const SoftRaster&) = delete;
+
+private:
+    struct Cell {
+        Uint32 glyph; // index into scaled, by Font::glyph_index()
+        Uint32 fg;
+        Uint32 bg;
+        Uint32 underline;
+    };
+
+    static constexpr size_t parallel_min_cells = 4096;
+
+    static Uint32 pack(const SDL_Color& c)
+    {
+        return (Uint32(c.a) << 24) | (Uint32(c.r) << 16) | (Uint32(c.g) << 8) | c.b;
+    }
+
+    /* Make a texture and buffers for cols x rows cells, all to be drawn. */
+    void resize(SDL_Renderer* renderer, int cols, int rows)
+    {
+        if (texture)
+            console::SDL_DestroyTexture(texture);
+        texture = console::SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STREAMING, cols * cw, rows * lh);
+        if (texture)
+            console::SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        ncols = cols;
+        nrows = rows;
+        pixels.assign(static_cast<size_t>(cols) * cw * rows * lh, 0);
+        // Not a cell put() makes, so all rows are dirty
+        front.assign(static_cast<size_t>(cols) * rows, { 0, 1, 1, 1 });
+    }
+
+    /* Nearest-neighbour resize of the font's masks to the current cell size. */
+    void scale_masks(Font& font)
+    {
+        // Glyphs are drawn scaled from the top of the cell, the rest is line spacing
+        glyph_h = std::min(lh, static_cast<int>(font.mask_h * font.scale));
+        size_t count = font.masks.size() / font.mask_h;
+        scaled.assign(count * glyph_h, 0);
+        for (size_t g = 0; g < count; ++g) {
+            for (int y = 0; y < glyph_h; ++y) {
+                Uint32 src = font.masks[g * font.mask_h + y * font.mask_h / glyph_h];
+                Uint64 bits = 0;
+                for (int x = 0; x < cw; ++x) {
+                    if (src & (1u << (x * font.mask_w / cw)))
+                        bits |= Uint64(1) << x;
+                }
+                scaled[g * glyph_h + y] = bits;
+            }
+        }
+        font_ = &font;
+    }
+
+    void raster_row(int r)
+    {
+        const int pitch = ncols * cw;
+        Uint32* base = &pixels[static_cast<size_t>(r) * lh * pitch];
+        const Cell* cells = &front[static_cast<size_t>(r) * ncols];
+        for (int c = 0; c < ncols; ++c) {
+            const Cell& cell = cells[c];
+            Uint32* dst = base + c * cw;
+            if (cell.glyph == U' ' && !cell.underline) {
+                for (int y = 0; y < lh; ++y)
+                    std::fill_n(dst + y * pitch, cw, cell.bg);
+                continue;
+            }
+
+            const Uint64* mask = &scaled[cell.glyph * glyph_h];
+            for (int y = 0; y < lh; ++y) {
+                Uint64 bits = y < glyph_h ? mask[y] : 0;
+                if (cell.underline && y == lh - 2)
+                    bits = ~Uint64(0);
+                expand_bits(dst + y * pitch, bits, cw, cell.fg, cell.bg);
+            }
+        }
+    }
+
+    /* Write w pixels, fg where a bit of bits is set and bg elsewhere. */
+    static void expand_bits(Uint32* dst, Uint64 bits, int w, Uint32 fg, Uint32 bg)
+    {
+        int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i fgv = _mm_set1_epi32(static_cast<int>(fg));
+        const __m128i bgv = _mm_set1_epi32(static_cast<int>(bg));
+        const __m128i lanes = _mm_set_epi32(8, 4, 2, 1);
+        for (; x + 4 <= w; x += 4) {
+            __m128i b = _mm_set1_epi32(static_cast<int>((bits >> x) & 0xF));
+            __m128i m = _mm_cmpeq_epi32(_mm_and_si128(b, lanes), lanes);
+            __m128i px = _mm_or_si128(_mm_and_si128(m, fgv), _mm_andnot_si128(m, bgv));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), px);
+        }
+#elif defined(__ARM_NEON)
+        const uint32x4_t fgv = vdupq_n_u32(fg);
+        const uint32x4_t bgv = vdupq_n_u32(bg);
+        const uint32_t lane_bits[4] = { 1, 2, 4, 8 };
+        const uint32x4_t lanes = vld1q_u32(lane_bits);
+        for (; x + 4 <= w; x += 4) {
+            uint32x4_t m = vtstq_u32(vdupq_n_u32(static_cast<uint32_t>((bits >> x) & 0xF)), lanes);
+            vst1q_u32(dst + x, vbslq_u32(m, fgv, bgv));
+        }
+#endif
+        for (; x < w; ++x)
+            dst[x] = ((bits >> x) & 1) ? fg : bg;
+    }
+
+    SDL_Texture* texture { nullptr };
+    Font* font_ { nullptr };
+    int ncols { 0 };
+    int nrows { 0 };
+    int cw { 0 };
+    int lh { 0 };
+    int glyph_h { 0 };
+    std::vector<Uint64> scaled; // glyph_h rows per glyph
+    std::vector<Uint32> pixels;
+    std::vector<Cell> front; // cells as in pixels
+    std::vector<Cell> back; // cells of the frame being built
+    std::vector<bool> dirty_rows;
+    std::vector<int> dirty_bands;
+    ThreadPool& pool;
+};
+
 using FontMap = std::map<std::pair<std::string, int>, Font>;
 struct FontLoader {
     FontLoader(SDL_Renderer* renderer)
@@ -683,6 +2301,11 @@ protected:
 };
 
 struct BMPFontLoader : public FontLoader {
+    // Size of a glyph on the sheet. The renderer is picked for it before
+    // the sheet can be loaded.
+    static constexpr int glyph_w = 8;
+    static constexpr int glyph_h = 12;
+
     BMPFontLoader(SDL_Renderer* renderer)
         : FontLoader(renderer)
     {
@@ -730,6 +2353,7 @@ struct BMPFontLoader : public FontLoader {
 
         console::SDL_BlitSurface(surface, NULL, conv_surface, NULL);
         console::SDL_FreeSurface(surface);
+        std::vector<Uint32> masks = build_glyph_masks(conv_surface, glyphs);
 
         SDL_Texture* texture = console::SDL_CreateTextureFromSurface(renderer, conv_surface);
         if (!texture) {
@@ -740,8 +2364,44 @@ struct BMPFontLoader : public FontLoader {
         textures.emplace_back(texture);
 
         // FIXME: hardcoded
-        auto result = fmap.emplace(key, Font(*this, texture, glyphs, 8, 12));
-        return &result.first->second;
+        auto result = fmap.emplace(key, Font(*this, texture, glyphs, glyph_w, glyph_h));
+        Font& font = result.first->second;
+        if (!masks.empty()) {
+            font.masks.assign(masks.begin(), masks.end());
+            font.mask_w = glyphs[0].rect.w;
+            font.mask_h = glyphs[0].rect.h;
+        }
+        return &font;
+    }
+
+    /* Read glyph bitmaps off the sheet: a pixel is set if it's opaque and bright. */
+    std::vector<Uint32> build_glyph_masks(SDL_Surface* sheet, const std::vector<Glyph>& glyphs)
+    {
+        std::vector<Uint32> masks;
+        if (glyphs.empty() || glyphs[0].rect.w > 32)
+            return masks;
+
+        const int gw = glyphs[0].rect.w;
+        const int gh = glyphs[0].rect.h;
+        masks.resize(glyphs.size() * gh);
+        const Uint8* pixels = static_cast<const Uint8*>(sheet->pixels);
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            const SDL_Rect& r = glyphs[i].rect;
+            for (int y = 0; y < gh && r.y + y < sheet->h; ++y) {
+                const Uint32* row = reinterpret_cast<const Uint32*>(pixels + (r.y + y) * sheet->pitch);
+                Uint32 bits = 0;
+                for (int x = 0; x < gw && r.x + x < sheet->w; ++x) {
+                    // RGBA masks as created above
+                    Uint32 p = row[r.x + x];
+                    Uint8 a = p & 0xFF;
+                    Uint8 lum = std::max({ p >> 24, (p >> 16) & 0xFF, (p >> 8) & 0xFF });
+                    if (a >= 128 && lum >= 128)
+                        bits |= 1u << x;
+                }
+                masks[i * gh + y] = bits;
+            }
+        }
+        return masks;
     }
 
     std::vector<Glyph> build_glyph_rects(int sheet_w, int sheet_h, int columns, int rows)
@@ -864,7 +2524,7 @@ public:
     EventEmitter& operator=(const EventEmitter&) = delete;
 
 private:
-    std::map<Uint32, std::deque<Handler>> handlers;
+    std::pmr::map<Uint32, std::pmr::deque<Handler>> handlers { memory::account(CONSOLE_MEMORY_EVENT_HANDLERS) };
 };
 
 struct MainWindow;
@@ -878,6 +2538,8 @@ struct WidgetContext {
     SDL_Renderer* renderer;
     EventEmitter* global_emitter;
     SDL_Point& mouse_coord;
+    // Reset by render_frame() once the frame is presented
+    memory::FrameArena frame_arena;
 };
 
 // TODO: needs work
@@ -914,6 +2576,11 @@ public:
         return context.mouse_coord;
     }
 
+    memory::FrameArena& frame_arena()
+    {
+        return context.frame_arena;
+    }
+
     void set_font(const std::string& file, const int size)
     {
         // XXX: check for error
@@ -953,6 +2620,11 @@ public:
         viewport = new_viewport;
     };
     virtual void on_resize() {};
+    /* Width that text is wrapped to, see make_logentry_lines(). */
+    virtual int wrap_width()
+    {
+        return viewport.w;
+    }
 
     virtual ~Widget() { }
 
@@ -970,6 +2642,7 @@ struct Prompt : public Widget {
     {
         input = &history.emplace_back(U"");
         prompt_text = U"> ";
+        entry.chunkable = false;
         // Create 1x1 texture for the cursor, it will be stretched to fit the font's line height and character width
         cursor_texture = console::SDL_CreateTexture(renderer(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, 1, 1);
         if (cursor_texture == nullptr)
@@ -1110,12 +2783,13 @@ struct Prompt : public Widget {
         }
     }
 
+    /* Rewrap prompt and input in place, reusing the entry's buffers. */
     void update_entry()
     {
-        std::u32string str = prompt_text + *input;
-        // entry.text = str;
-        // std::cerr << "Prompt update_entry(): " << to_utf8(str) << std::endl;
-        make_logentry_lines(*this, entry, str);
+        entry.text.assign(prompt_text);
+        entry.text += *input;
+        entry.index_breaks();
+        make_logentry_lines(*this, entry, entry.text);
     }
 
     void render_cursor(const int scroll_offset)
@@ -1165,7 +2839,7 @@ struct Prompt : public Widget {
     // The text of the prompt itself.
     std::u32string prompt_text;
     // The input portion of the prompt.
-    std::u32string* input;
+    std::pmr::u32string* input;
     // Prompt text was changed flag
     bool rebuild { true };
     size_t cursor { 0 }; // position of cursor within an entry
@@ -1175,7 +2849,7 @@ struct Prompt : public Widget {
      * For input history.
      * use deque to hold a stable reference.
      */
-    std::deque<std::u32string> history;
+    std::pmr::deque<std::pmr::u32string> history { memory::account(CONSOLE_MEMORY_HISTORY) };
     int history_idx;
 };
 
@@ -1319,6 +2993,73 @@ private:
     }
 };
 
+/*
+ * Horizontal scrollbar for the unwrapped view. value is the first column
+ * shown, out of range columns of which page fit. Dragging it emits
+ * value_changed.
+ */
+struct HScrollbar : public Widget {
+    HScrollbar(Widget* parent)
+        : Widget(parent)
+    {
+        connect_global(SDL_MOUSEBUTTONDOWN, [this](SDL_Event& e) {
+            if (visible && e.button.button == SDL_BUTTON_LEFT && in_rect(e.button.x, e.button.y, viewport)) {
+                dragging = true;
+                drag_to(e.button.x);
+            }
+        });
+        connect_global(SDL_MOUSEBUTTONUP, [this](SDL_Event&) {
+            dragging = false;
+        });
+        connect_global(SDL_MOUSEMOTION, [this](SDL_Event& e) {
+            if (dragging)
+                drag_to(e.motion.x);
+        });
+    }
+
+    void set(int value, int range, int page)
+    {
+        this->value = value;
+        this->range = range;
+        this->page = page;
+    }
+
+    void render() override
+    {
+        if (!visible)
+            return;
+        set_draw_color(renderer(), colors::white);
+        console::SDL_RenderDrawRect(renderer(), &viewport);
+        if (range > page) {
+            SDL_Rect thumb = viewport;
+            thumb.w = std::max(10, static_cast<int>(static_cast<long long>(viewport.w) * page / range));
+            // value may be past the end after scrolling to shorter lines
+            const int shown = std::min(value, range - page);
+            thumb.x += static_cast<int>(static_cast<long long>(viewport.w - thumb.w) * shown / (range - page));
+            console::SDL_RenderFillRect(renderer(), &thumb);
+        }
+        set_draw_color(renderer(), colors::darkgray);
+    }
+
+    bool visible { false };
+
+private:
+    /* Centre the thumb on x. */
+    void drag_to(int x)
+    {
+        if (range <= page || viewport.w <= 0)
+            return;
+        long long column = static_cast<long long>(x - viewport.x) * range / viewport.w - page / 2;
+        value = static_cast<int>(std::clamp<long long>(column, 0, range - page));
+        emit(InternalEventType::value_changed, &value);
+    }
+
+    int value { 0 };
+    int range { 0 };
+    int page { 0 };
+    bool dragging { false };
+};
+
 class Button : public Widget {
 public:
     Button(Widget* parent, std::u32string& label, SDL_Color color)
@@ -1395,6 +3136,90 @@ public:
     bool depressed { false };
 };
 
+/*
+ * Last-writer-wins text for the status line. Writers swap in a new string
+ * and free whatever the render thread hadn't picked up yet. The render
+ * thread swaps in nullptr, so each string has exactly one owner.
+ */
+struct StatusSlots {
+    std::atomic<std::u32string*> pending[CONSOLE_STATUS_SLOTS] {};
+
+    void set(int slot, std::u32string* text)
+    {
+        delete pending[slot].exchange(text, std::memory_order_acq_rel);
+    }
+
+    std::u32string* take(int slot)
+    {
+        return pending[slot].exchange(nullptr, std::memory_order_acquire);
+    }
+
+    ~StatusSlots()
+    {
+        for (int i = 0; i < CONSOLE_STATUS_SLOTS; ++i)
+            delete take(i);
+    }
+};
+
+/* Single line below the toolbar showing the status slots. */
+struct StatusBar : public Widget {
+    StatusBar(Widget* parent)
+        : Widget(parent)
+    {
+    }
+
+    /* Pick up new slot text. Returns true if visibility changed. */
+    bool sample(StatusSlots& slots)
+    {
+        bool was_visible = visible();
+        for (int i = 0; i < CONSOLE_STATUS_SLOTS; ++i) {
+            if (auto* text = slots.take(i)) {
+                cells[i] = std::move(*text);
+                delete text;
+            }
+        }
+        return was_visible != visible();
+    }
+
+    bool visible()
+    {
+        for (auto& c : cells) {
+            if (!c.empty())
+                return true;
+        }
+        return false;
+    }
+
+    int height()
+    {
+        return visible() ? font->line_height : 0;
+    }
+
+    void render() override
+    {
+        if (!visible())
+            return;
+
+        set_draw_color(renderer(), colors::charcoal);
+        console::SDL_RenderDrawRect(renderer(), &viewport);
+        set_draw_color(renderer(), colors::darkgray);
+
+        const int cw = font->char_width;
+        const size_t slot_cols = std::max(1, (viewport.w / cw) / CONSOLE_STATUS_SLOTS);
+        int x = viewport.x + cw / 2;
+        for (auto& c : cells) {
+            // Leave a column between slots
+            font->render(renderer(), std::u32string_view(c).substr(0, slot_cols - 1), x, viewport.y);
+            x += slot_cols * cw;
+        }
+    }
+
+    StatusBar(const StatusBar&) = delete;
+    StatusBar& operator=(const StatusBar&) = delete;
+
+    std::u32string cells[CONSOLE_STATUS_SLOTS];
+};
+
 struct Toolbar : public Widget {
     Toolbar(Widget* parent);
     ~Toolbar() {};
@@ -1412,16 +3237,7 @@ struct Toolbar : public Widget {
 };
 
 struct InputLineWaiter {
-    EventEmitter& emitter;
-
-    InputLineWaiter(EventEmitter& emitter)
-        : emitter(emitter)
-    {
-        emitter.connect(InternalEventType::new_input_line, [this](SDL_Event& e) {
-            auto* str = static_cast<std::u32string*>(e.user.data1);
-            (str == nullptr) ? push(U"") : push(*str);
-        });
-    }
+    InputLineWaiter() = default;
 
     void push(std::u32string s)
     {
@@ -1473,16 +3289,545 @@ private:
     std::atomic<bool> completed;
 };
 
+struct Cell {
+    char32_t ch { U' ' };
+    TextAttr attr;
+
+    bool operator==(const Cell& o) const
+    {
+        return ch == o.ch && attr == o.attr;
+    }
+};
+
+/*
+ * A rows x columns grid of cells driven by a subset of VT100: cursor
+ * movement (CUU, CUD, CUF, CUB, CNL, CPL, CHA, VPA, CUP), erase in display
+ * and line, SGR, save/restore cursor, CR, LF, BS and TAB. LF also returns
+ * the cursor to the first column, as a tty with onlcr would.
+ */
+struct ScreenBuffer {
+    int rows { 0 };
+    int cols { 0 };
+    std::vector<Cell> cells;
+
+    /* Keeps the top left of the old content. */
+    void resize(int new_rows, int new_cols)
+    {
+        new_rows = std::max(1, new_rows);
+        new_cols = std::max(1, new_cols);
+        if (new_rows == rows && new_cols == cols)
+            return;
+
+        std::vector<Cell> resized(new_rows * new_cols);
+        for (int r = 0; r < std::min(rows, new_rows); ++r) {
+            std::copy_n(cells.begin() + r * cols, std::min(cols, new_cols), resized.begin() + r * new_cols);
+        }
+        cells.swap(resized);
+        rows = new_rows;
+        cols = new_cols;
+        row = std::min(row, rows - 1);
+        col = std::min(col, cols - 1);
+        wrap_pending = false;
+    }
+
+    Cell& at(int r, int c)
+    {
+        return cells[r * cols + c];
+    }
+
+    void write(std::u32string_view text)
+    {
+        // A sequence split across writes is completed here.
+        std::u32string joined;
+        if (!partial.empty()) {
+            joined = partial;
+            joined += text;
+            text = joined;
+            partial.clear();
+        }
+
+        for (size_t i = 0; i < text.length(); ++i) {
+            auto ch = text[i];
+            switch (ch) {
+            case U'\x1b': {
+                auto end = control(text, i);
+                if (end == std::u32string_view::npos) {
+                    partial = text.substr(i);
+                    return;
+                }
+                i = end - 1;
+                break;
+            }
+            case U'\r':
+                move_to(row, 0);
+                break;
+            case U'\n':
+                line_feed();
+                col = 0;
+                break;
+            case U'\b':
+                move_to(row, col - 1);
+                break;
+            case U'\t':
+                move_to(row, (col / 8 + 1) * 8);
+                break;
+            default:
+                if (ch >= 0x20)
+                    put(ch);
+                break;
+            }
+        }
+    }
+
+private:
+    void put(char32_t ch)
+    {
+        if (wrap_pending) {
+            line_feed();
+            col = 0;
+            wrap_pending = false;
+        }
+        at(row, col) = { ch, attr };
+        if (col == cols - 1)
+            wrap_pending = true;
+        else
+            col++;
+    }
+
+    void move_to(int r, int c)
+    {
+        row = std::clamp(r, 0, rows - 1);
+        col = std::clamp(c, 0, cols - 1);
+        wrap_pending = false;
+    }
+
+    void line_feed()
+    {
+        if (row < rows - 1) {
+            row++;
+            return;
+        }
+        std::copy(cells.begin() + cols, cells.end(), cells.begin());
+        erase(cells.size() - cols, cells.size());
+    }
+
+    /* Blank cells [from, to), keeping the current background. */
+    void erase(size_t from, size_t to)
+    {
+        Cell blank;
+        blank.attr.bg = attr.bg;
+        std::fill(cells.begin() + from, cells.begin() + to, blank);
+    }
+
+    /*
+     * Handle the sequence starting at the ESC at text[pos]. Returns the
+     * index past it, or npos if the sequence isn't complete yet. A malformed
+     * sequence, or one longer than max_sequence, is dropped and the text
+     * from where it went wrong is handled as ordinary output.
+     */
+    size_t control(std::u32string_view text, size_t pos)
+    {
+        constexpr auto npos = std::u32string_view::npos;
+        const size_t limit = pos + max_sequence;
+        size_t i = pos + 1;
+        if (i >= text.length())
+            return npos;
+
+        switch (text[i]) {
+        case U'[':
+            break;
+        case U']':
+            while (++i < text.length()) {
+                if (i == limit)
+                    return i;
+                if (text[i] == U'\a')
+                    return i + 1;
+                if (text[i] == U'\x1b')
+                    return (i + 1 < text.length()) ? i + 2 : npos;
+            }
+            return npos;
+        case U'7':
+            saved_row = row;
+            saved_col = col;
+            return i + 1;
+        case U'8':
+            move_to(saved_row, saved_col);
+            return i + 1;
+        case U'c':
+            attr = {};
+            erase(0, cells.size());
+            move_to(0, 0);
+            return i + 1;
+        default:
+            return i + 1;
+        }
+
+        size_t params = ++i;
+        for (; i < text.length() && (text[i] < 0x40 || text[i] > 0x7E); ++i) {
+            if (i == limit || text[i] < 0x20 || text[i] > 0x7E)
+                return i;
+        }
+        if (i == text.length())
+            return npos;
+
+        auto p = text.substr(params, i - params);
+        // Private modes (ESC[?25l and such) aren't supported
+        if (!p.empty() && (p[0] < U'0' || p[0] > U'9') && p[0] != U';')
+            return i + 1;
+
+        int args[2] = { 0, 0 };
+        int n = 0;
+        for (auto c : p) {
+            if (c == U';') {
+                if (++n == 2)
+                    break;
+            } else if (c >= U'0' && c <= U'9') {
+                args[n] = std::min(args[n] * 10 + static_cast<int>(c - U'0'), 0xFFFF);
+            }
+        }
+        const int count = std::max(1, args[0]);
+        const size_t cursor = row * cols + col;
+
+        switch (text[i]) {
+        case U'A':
+            move_to(row - count, col);
+            break;
+        case U'B':
+            move_to(row + count, col);
+            break;
+        case U'C':
+            move_to(row, col + count);
+            break;
+        case U'D':
+            move_to(row, col - count);
+            break;
+        case U'E':
+            move_to(row + count, 0);
+            break;
+        case U'F':
+            move_to(row - count, 0);
+            break;
+        case U'G':
+            move_to(row, count - 1);
+            break;
+        case U'd':
+            move_to(count - 1, col);
+            break;
+        case U'H':
+        case U'f':
+            move_to(count - 1, std::max(1, args[1]) - 1);
+            break;
+        case U'J':
+            if (args[0] == 0)
+                erase(cursor, cells.size());
+            else if (args[0] == 1)
+                erase(0, cursor + 1);
+            else
+                erase(0, cells.size());
+            break;
+        case U'K':
+            if (args[0] == 0)
+                erase(cursor, (row + 1) * cols);
+            else if (args[0] == 1)
+                erase(row * cols, cursor + 1);
+            else
+                erase(row * cols, (row + 1) * cols);
+            break;
+        case U'm':
+            apply_sgr(p, attr);
+            break;
+        case U's':
+            saved_row = row;
+            saved_col = col;
+            break;
+        case U'u':
+            move_to(saved_row, saved_col);
+            break;
+        }
+        return i + 1;
+    }
+
+    int row { 0 };
+    int col { 0 };
+    int saved_row { 0 };
+    int saved_col { 0 };
+    // The last column was written, the next character goes on a new line.
+    bool wrap_pending { false };
+    TextAttr attr;
+    // Unfinished sequence from the last write, at most max_sequence long.
+    std::u32string partial;
+    static constexpr size_t max_sequence = 256;
+};
+
+/*
+ * Draws a ScreenBuffer. Cells are drawn into a target texture that is kept
+ * between frames, and a copy of what was drawn (the front buffer) is
+ * compared with the screen so only changed cells are redrawn. Falls back
+ * to drawing every cell when the renderer lacks target textures.
+ */
+struct ScreenView : public Widget {
+    ScreenBuffer screen;
+
+    ScreenView(Widget* parent)
+        : Widget(parent)
+    {
+    }
+
+    ~ScreenView()
+    {
+        if (target)
+            console::SDL_DestroyTexture(target);
+    }
+
+    /* Draw at x, y of the current viewport with the default colours. */
+    void render(int x, int y, const SDL_Color& fg, const SDL_Color& bg)
+    {
+        const int cw = font->char_width;
+        const int lh = font->line_height;
+        const int w = screen.cols * cw;
+        const int h = screen.rows * lh;
+
+        // A failed target isn't retried until the size changes
+        if (target_w != w || target_h != h) {
+            if (target)
+                console::SDL_DestroyTexture(target);
+            target = console::SDL_CreateTexture(renderer(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+            target_w = w;
+            target_h = h;
+            front.clear();
+        }
+
+        if (!target) {
+            queue_cells(x, y, fg, bg, true);
+            batch.flush(renderer(), font->texture);
+            return;
+        }
+
+        bool full = front.size() != screen.cells.size()
+            || std::memcmp(&fg, &drawn_fg, sizeof(fg)) || std::memcmp(&bg, &drawn_bg, sizeof(bg));
+        if (full) {
+            front.assign(screen.cells.size(), {});
+            drawn_fg = fg;
+            drawn_bg = bg;
+        }
+        if (queue_cells(0, 0, fg, bg, full)) {
+            console::SDL_SetRenderTarget(renderer(), target);
+            batch.flush(renderer(), font->texture);
+            console::SDL_SetRenderTarget(renderer(), nullptr);
+        }
+
+        SDL_Rect dst = { x, y, w, h };
+        console::SDL_RenderCopy(renderer(), target, nullptr, &dst);
+    }
+
+    ScreenView(const ScreenView&) = delete;
+    ScreenView& operator=(const ScreenView&) = delete;
+
+private:
+    /* Queue changed cells, or all with full. Returns false if none. */
+    bool queue_cells(int x, int y, const SDL_Color& fg, const SDL_Color& bg, bool full)
+    {
+        const int cw = font->char_width;
+        const int lh = font->line_height;
+        bool any = false;
+        for (int r = 0; r < screen.rows; ++r) {
+            for (int c = 0; c < screen.cols; ++c) {
+                size_t i = r * screen.cols + c;
+                auto& cell = screen.cells[i];
+                if (!full && cell == front[i])
+                    continue;
+                if (i < front.size())
+                    front[i] = cell;
+                any = true;
+
+                SDL_Color cfg = cell.attr.fg.a ? cell.attr.fg : fg;
+                SDL_Color cbg = cell.attr.bg.a ? cell.attr.bg : bg;
+                if (cell.attr.flags & TextAttr::inverse)
+                    std::swap(cfg, cbg);
+                if (cell.attr.flags & TextAttr::bold) {
+                    cfg.r += (255 - cfg.r) / 3;
+                    cfg.g += (255 - cfg.g) / 3;
+                    cfg.b += (255 - cfg.b) / 3;
+                }
+
+                SDL_Rect rect = { x + c * cw, y + r * lh, cw, lh };
+                batch.add_rect(rect, cbg);
+                if (cell.attr.flags & TextAttr::underline)
+                    batch.add_rect({ rect.x, rect.y + lh - 2, cw, 1 }, cfg);
+                if (cell.ch != U' ')
+                    batch.add_text(*font, std::u32string_view(&cell.ch, 1), rect.x, rect.y, cfg);
+            }
+        }
+        return any;
+    }
+
+    SDL_Texture* target { nullptr };
+    int target_w { 0 };
+    int target_h { 0 };
+    // Cells as last drawn into target
+    std::vector<Cell> front;
+    SDL_Color drawn_fg {};
+    SDL_Color drawn_bg {};
+    GlyphBatch batch;
+};
+
+/*
+ * Debug overlay with the console's own cost, toggled with F3. Samples are
+ * taken once per frame into a ring while shown, and not at all while
+ * hidden.
+ */
+struct PerfHud : public Widget {
+    struct Sample {
+        Clock::time_point start; // frame start
+        Uint32 render_us;
+        Uint32 dispatch_us; // SDL events and API tasks since the last frame
+        Uint32 wrap_us;
+        Uint32 queue_depth;
+        Uint32 draw_calls;
+        Uint64 lines_ingested; // running total
+        Uint64 scrollback_bytes;
+    };
+
+    PerfHud(Widget* parent)
+        : Widget(parent)
+    {
+    }
+
+    void toggle()
+    {
+        visible = !visible;
+        count = 0;
+        dispatch_us = 0;
+    }
+
+    void add_sample(const Sample& sample)
+    {
+        samples[head] = sample;
+        samples[head].dispatch_us = dispatch_us;
+        head = (head + 1) % samples.size();
+        count = std::min(count + 1, samples.size());
+        dispatch_us = 0;
+    }
+
+    void render() override
+    {
+        if (count < 2)
+            return;
+
+        // Averages over the samples in the ring
+        const Sample& last = at(count - 1);
+        const Sample& first = at(0);
+        Uint64 render_us = 0, dispatch = 0, wrap_us = 0;
+        Uint32 max_interval = 1;
+        for (size_t i = 1; i < count; ++i) {
+            render_us += at(i).render_us;
+            dispatch += at(i).dispatch_us;
+            wrap_us += at(i).wrap_us;
+            max_interval = std::max(max_interval, interval_us(i));
+        }
+        const double n = count - 1;
+        const double span = std::chrono::duration<double>(last.start - first.start).count();
+        const double lines_per_sec = span > 0 ? (last.lines_ingested - first.lines_ingested) / span : 0;
+
+        char lines[3][96];
+        std::snprintf(lines[0], sizeof(lines[0]), "frame %.1fms  render %.2f dispatch %.2f wrap %.2f",
+            span * 1000 / n, render_us / n / 1000, dispatch / n / 1000, wrap_us / n / 1000);
+        std::snprintf(lines[1], sizeof(lines[1]), "queue %u  in %.0f lines/s  draw calls %u",
+            last.queue_depth, lines_per_sec, last.draw_calls);
+        std::snprintf(lines[2], sizeof(lines[2]), "scrollback %llu KiB",
+            static_cast<unsigned long long>(last.scrollback_bytes / 1024));
+
+        const int cw = font->char_width;
+        const int lh = font->line_height;
+        const int graph_h = lh * 2;
+        SDL_Rect box = { viewport.x + viewport.w - 52 * cw, viewport.y, 52 * cw, lh * 3 + graph_h + 4 };
+        set_draw_color(renderer(), colors::charcoal);
+        console::SDL_RenderFillRect(renderer(), &box);
+
+        // Sparkline of frame intervals, scaled to the longest
+        const int bar_w = std::max(1, box.w / static_cast<int>(samples.size()));
+        bars.clear();
+        for (size_t i = 1; i < count; ++i) {
+            int h = std::max(1, static_cast<int>(static_cast<Uint64>(interval_us(i)) * graph_h / max_interval));
+            bars.push_back({ box.x + static_cast<int>(i) * bar_w, box.y + box.h - 2 - h, bar_w, h });
+        }
+        set_draw_color(renderer(), colors::lightgray);
+        console::SDL_RenderFillRects(renderer(), bars.data(), static_cast<int>(bars.size()));
+        set_draw_color(renderer(), colors::darkgray);
+
+        int y = box.y;
+        for (auto& l : lines) {
+            text.assign(l, l + std::strlen(l));
+            font->render(renderer(), text, box.x + cw / 2, y);
+            y += lh;
+        }
+    }
+
+    PerfHud(const PerfHud&) = delete;
+    PerfHud& operator=(const PerfHud&) = delete;
+
+    bool visible { false };
+    Uint64 dispatch_us { 0 }; // added to by the main loop while visible
+
+private:
+    /* i-th oldest sample */
+    const Sample& at(size_t i) const
+    {
+        return samples[(head + samples.size() - count + i) % samples.size()];
+    }
+
+    Uint32 interval_us(size_t i) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(at(i).start - at(i - 1).start).count();
+    }
+
+    std::array<Sample, 120> samples;
+    size_t head { 0 };
+    size_t count { 0 };
+    std::vector<SDL_Rect> bars;
+    std::u32string text;
+};
+
 struct LogScreen : public Widget {
     // Use deque to hold a stable reference.
-    std::deque<LogEntry> entries;
+    std::pmr::deque<LogEntry> entries { memory::account(CONSOLE_MEMORY_ENTRIES) };
     Prompt prompt;
     Scrollbar scrollbar;
+    HScrollbar hscrollbar;
+    // Cell grid shown instead of the scrollback in screen mode.
+    ScreenView screen;
+    PerfHud hud;
+    bool screen_mode { false };
     // Scrollbar could be made optional.
     int scroll_value { 0 };
+    // When off, lines break only at newlines and scroll horizontally
+    bool line_wrap { true };
+    int hscroll_value { 0 }; // first column shown when not wrapping
+    int widest_row { 0 }; // longest line drawn last frame, in columns
     SDL_Point viewport_offset;
     int max_lines { default_scrollback }; /* max numbers of lines allowed */
     int num_lines { 0 };
+    // Entries added through the API, by id. Entries are only ever added at
+    // the front and evicted from the back, so the pointers stay valid.
+    std::pmr::unordered_map<Console_LineId, LogEntry*> entry_ids { memory::account(CONSOLE_MEMORY_ENTRIES) };
+    size_t num_removed { 0 }; // removed entries still in the deque
+    // Evicted entries, handed to the reclaimer a batch at a time
+    std::pmr::vector<LogEntry> evicted { memory::account(CONSOLE_MEMORY_ENTRIES) };
+    static constexpr size_t evict_batch = 256;
+    Reclaimer reclaimer;
+    static constexpr size_t rewrap_chunk = 256; // entries per task in rewrap()
+    static constexpr int hscroll_step = 4; // columns per wheel notch when not wrapping
+    size_t scrollback_bytes { 0 }; // sum of the entries' accounted_bytes
+    Console_LineId newest_id { 0 }; // highest id added, even if since removed
+    bool overwrite_on_cr { false };
+    SDL_Color font_color { colors::white };
+    SDL_Color bg_color { colors::darkgray };
+    GlyphBatch batch;
+    // Shared by the raster and rewrapping on resize
+    ThreadPool pool { ThreadPool::default_size() };
+    // Set when text is drawn on the CPU, see SoftRaster
+    std::unique_ptr<SoftRaster> raster;
+    bool rastering { false }; // raster is in use this frame
     bool mouse_depressed { false };
     SDL_Point mouse_motion_start { -1, -1 };
     SDL_Point mouse_motion_end { -1, -1 };
@@ -1491,6 +3836,9 @@ struct LogScreen : public Widget {
         : Widget(parent)
         , prompt(this)
         , scrollbar(this, rows())
+        , hscrollbar(this)
+        , screen(this)
+        , hud(this)
     {
         connect_global(SDL_MOUSEBUTTONDOWN, [this](SDL_Event& e) {
             on_mouse_button_down(e.button);
@@ -1501,6 +3849,12 @@ struct LogScreen : public Widget {
         });
 
         connect_global(SDL_MOUSEWHEEL, [this](SDL_Event& e) {
+            if (!line_wrap && (console::SDL_GetModState() & KMOD_SHIFT)) {
+                on_hscroll(-e.wheel.y * hscroll_step);
+                return;
+            }
+            if (e.wheel.x)
+                on_hscroll(e.wheel.x * hscroll_step);
             on_scroll(e.wheel.y);
         });
 
@@ -1524,21 +3878,57 @@ struct LogScreen : public Widget {
         scrollbar.connect(InternalEventType::value_changed, [this](SDL_Event& e) {
             scroll_value = *static_cast<int*>(e.user.data1);
         });
+
+        hscrollbar.connect(InternalEventType::value_changed, [this](SDL_Event& e) {
+            hscroll_value = *static_cast<int*>(e.user.data1);
+        });
     }
 
-    int on_key_down(const SDL_KeyboardEvent& e)
+    int wrap_width() override
     {
-        auto sym = e.keysym.sym;
-        switch (sym) {
-        case SDLK_TAB:
-            on_new_input_line(from_utf8("(tab)"));
-            break;
-        /* copy */
-        case SDLK_c:
-            if (console::SDL_GetModState() & KMOD_CTRL) {
-                on_set_clipboard_text();
-            }
-            break;
+        return line_wrap ? viewport.w : INT_MAX;
+    }
+
+    /*
+     * Turn wrapping of the scrollback on or off. Unwrapped, lines only
+     * break at newlines, and resizing needs no rewrap.
+     */
+    void set_line_wrap(bool enable)
+    {
+        if (enable == line_wrap)
+            return;
+        line_wrap = enable;
+        hscroll_value = 0;
+        on_resize();
+        if (!line_wrap)
+            rewrap();
+    }
+
+    /* Scroll the unwrapped view by columns, right if positive. */
+    void on_hscroll(int columns)
+    {
+        if (line_wrap || screen_mode)
+            return;
+        hscroll_value = std::clamp(hscroll_value + columns, 0, std::max(0, widest_row - this->columns()));
+    }
+
+    int on_key_down(const SDL_KeyboardEvent& e)
+    {
+        auto sym = e.keysym.sym;
+        switch (sym) {
+        case SDLK_TAB:
+            emit_global(InternalEventType::complete_input, &prompt);
+            break;
+
+        case SDLK_F3:
+            hud.toggle();
+            break;
+        /* copy */
+        case SDLK_c:
+            if (console::SDL_GetModState() & KMOD_CTRL) {
+                on_set_clipboard_text();
+            }
+            break;
 
         /* paste */
         case SDLK_v:
@@ -1598,10 +3988,21 @@ struct LogScreen : public Widget {
         mouse_depressed = false;
     }
 
+    /* O(1) here; the entries are freed by the reclaimer. */
     void clear()
     {
+        struct Scrollback {
+            decltype(LogScreen::entries) all;
+            decltype(LogScreen::entry_ids) ids;
+            decltype(LogScreen::evicted) pending;
+        };
+        reclaimer.dispose(Scrollback { std::move(entries), std::move(entry_ids), std::move(evicted) });
         entries.clear();
+        entry_ids.clear();
+        evicted.clear();
+        num_removed = 0;
         num_lines = 0;
+        scrollback_bytes = 0;
         set_scroll_value(0);
         scrollbar.set_range(rows());
     }
@@ -1641,6 +4042,9 @@ struct LogScreen : public Widget {
 
     void on_scroll(const ScrollDirection dir)
     {
+        if (screen_mode)
+            return;
+
         switch (dir) {
         case ScrollDirection::up:
             scroll_value += 1;
@@ -1662,19 +4066,75 @@ struct LogScreen : public Widget {
 
     void on_resize() override
     {
+        CONSOLE_TRACE_SCOPE("LogScreen::on_resize");
         viewport.w = parent->viewport.w;
         viewport.h = parent->viewport.h;
         scrollbar.set_viewport({ viewport.w - font->char_width * 2, viewport.y, font->char_width * 2, viewport.h });
         adjust_viewport();
-        num_lines = 0;
         prompt.on_resize();
-        /*
-         * TODO: we probably don't need to rebuild everything outside
-         * visible view.
-         */
-        for (auto& e : entries) {
-            update_entry(e);
+        // Unwrapped lines don't depend on the width
+        if (line_wrap)
+            rewrap();
+    }
+
+    /*
+     * Wrap every entry again for the current width. Entries are independent,
+     * so they are split into chunks that the pool's threads take in turn,
+     * starting from the one in view and moving out. Each chunk sums its rows
+     * and bytes into a slot of its own; those are merged at the end.
+     */
+    void rewrap()
+    {
+        CONSOLE_TRACE_SCOPE("LogScreen::rewrap");
+        struct Sums {
+            int rows { 0 };
+            ptrdiff_t bytes { 0 };
+        };
+        auto start = Clock::now();
+        const size_t nchunks = (entries.size() + rewrap_chunk - 1) / rewrap_chunk;
+
+        // Find the entry at the bottom of the view, by the old wrap
+        size_t anchor = 0;
+        for (int rows = 0; anchor + 1 < entries.size(); ++anchor) {
+            rows += static_cast<int>(entries[anchor].size);
+            if (rows > scroll_value)
+                break;
+        }
+        std::vector<size_t> order;
+        order.reserve(nchunks);
+        const size_t first = anchor / rewrap_chunk;
+        for (size_t d = 0; order.size() < nchunks; ++d) {
+            if (first + d < nchunks)
+                order.push_back(first + d);
+            if (d && d <= first)
+                order.push_back(first - d);
+        }
+
+        std::vector<Sums> sums(nchunks);
+        const int width = wrap_width();
+        const int advance = font->char_width;
+        pool.parallel_for(nchunks, [&](size_t i) {
+            size_t chunk = order[i];
+            size_t end = std::min(entries.size(), (chunk + 1) * rewrap_chunk);
+            Sums& sum = sums[chunk];
+            for (size_t j = chunk * rewrap_chunk; j < end; ++j) {
+                LogEntry& entry = entries[j];
+                wrap_entry(entry, width, advance);
+                sum.rows += static_cast<int>(entry.size);
+                size_t bytes = entry.memory_usage();
+                sum.bytes += static_cast<ptrdiff_t>(bytes) - static_cast<ptrdiff_t>(entry.accounted_bytes);
+                entry.accounted_bytes = bytes;
+            }
+        });
+
+        num_lines = 0;
+        for (auto& sum : sums) {
+            num_lines += sum.rows;
+            scrollback_bytes += sum.bytes;
         }
+        scrollbar.set_range(num_lines);
+        tally.wraps += entries.size();
+        tally.wrap_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
     }
 
     void set_viewport(SDL_Rect new_viewport) override
@@ -1700,8 +4160,9 @@ struct LogScreen : public Widget {
         int w = viewport.w - (margin * 2);
         // max width respect to font and margin
         int wfit = (w / font->char_width) * font->char_width;
-        // max height
-        int h = viewport.h - viewport_offset.y - margin;
+        // max height, less the horizontal scrollbar's
+        const int hbar_h = font->char_width * 2;
+        int h = viewport.h - viewport_offset.y - margin - (line_wrap ? 0 : hbar_h);
         // max height with respect to font and margin
         int hfit = (h / font->line_height) * font->line_height;
 
@@ -1709,18 +4170,112 @@ struct LogScreen : public Widget {
         viewport.y = viewport_offset.y + margin;
         viewport.w = wfit;
         viewport.h = hfit;
+        hscrollbar.visible = !line_wrap;
+        hscrollbar.set_viewport({ viewport.x, viewport.y + viewport.h, viewport.w, hbar_h });
+        // The grid takes the rows above the prompt
+        screen.screen.resize(rows() - 1, columns());
+    }
+
+    void set_screen_mode(bool enable)
+    {
+        screen_mode = enable;
+        set_scroll_value(0);
+    }
+
+    void on_new_output_line(std::u32string_view text, Console_LineId id = 0)
+    {
+        add_output_entry(make_output_entry(text, overwrite_on_cr), id);
     }
 
-    void on_new_output_line(const std::u32string& text)
+    /* Add an entry from make_output_entry(); all that's left is the wrap. */
+    void add_output_entry(LogEntry&& entry, Console_LineId id = 0)
     {
-        LogEntry& l = create_entry(EntryType::output, text);
+        LogEntry& l = create_entry(std::move(entry));
         update_entry(l);
+        if (id) {
+            l.id = id;
+            entry_ids[id] = &l;
+            newest_id = std::max(newest_id, id);
+        }
+    }
+
+    LogEntry* find_entry(Console_LineId id)
+    {
+        auto it = entry_ids.find(id);
+        return (it == entry_ids.end()) ? nullptr : it->second;
+    }
+
+    void on_update_line(Console_LineId id, const std::u32string& text)
+    {
+        if (auto* entry = find_entry(id)) {
+            entry->text.clear();
+            entry->write_pos = std::u32string::npos;
+            entry->attrs.clear();
+            entry->attr_state = {};
+            set_entry_text(*entry, text);
+            rewrap_entry(*entry);
+        }
+    }
+
+    void on_append_to_line(Console_LineId id, const std::u32string& text)
+    {
+        if (auto* entry = find_entry(id)) {
+            set_entry_text(*entry, text);
+            rewrap_entry(*entry);
+        }
+    }
+
+    /*
+     * Removed entries are left in place, empty, until they're evicted.
+     * The deque is compacted once they make up half of it.
+     */
+    void on_remove_line(Console_LineId id)
+    {
+        auto* entry = find_entry(id);
+        if (!entry)
+            return;
+
+        entry_ids.erase(id);
+        num_lines -= entry->size;
+        scrollback_bytes -= entry->accounted_bytes;
+        entry->accounted_bytes = 0;
+        entry->clear();
+        entry->text.clear();
+        entry->text.shrink_to_fit();
+        entry->index_breaks();
+        entry->breaks.shrink_to_fit();
+        entry->id = 0;
+        entry->removed = true;
+        scrollbar.set_range(num_lines);
+
+        if (++num_removed > 64 && num_removed > entries.size() / 2) {
+            std::erase_if(entries, [](const LogEntry& e) { return e.removed; });
+            num_removed = 0;
+            entry_ids.clear();
+            for (auto& e : entries) {
+                if (e.id)
+                    entry_ids[e.id] = &e;
+            }
+        }
+    }
+
+    void set_entry_text(LogEntry& entry, std::u32string_view text)
+    {
+        append_entry_text(entry, text, overwrite_on_cr);
+    }
+
+    /* Rewrap a single entry in place. */
+    void rewrap_entry(LogEntry& entry)
+    {
+        num_lines -= entry.size;
+        update_entry(entry);
     }
 
     // TODO: cleanup, most of this belongs in Prompt
-    void on_new_input_line(const std::u32string& text)
+    void on_new_input_line(std::u32string_view text)
     {
-        auto both = prompt.prompt_text + text;
+        std::u32string both = prompt.prompt_text;
+        both += text;
         auto& l = create_entry(EntryType::input, both);
         prompt.history.emplace_back(text);
 
@@ -1740,7 +4295,9 @@ struct LogScreen : public Widget {
     {
         make_logentry_lines(*this, entry, entry.text);
         num_lines += entry.size;
-        // XXX: during resize, update_entry is called for every line
+        scrollback_bytes -= entry.accounted_bytes;
+        entry.accounted_bytes = entry.memory_usage();
+        scrollback_bytes += entry.accounted_bytes;
         scrollbar.set_range(num_lines);
     }
 
@@ -1750,41 +4307,84 @@ struct LogScreen : public Widget {
      */
     LogEntry&
     create_entry(const EntryType line_type,
-        const std::u32string& text)
+        std::u32string_view text)
+    {
+        return create_entry(LogEntry(line_type, text));
+    }
+
+    LogEntry& create_entry(LogEntry&& entry)
     {
-        entries.emplace_front(line_type, text);
+        entries.push_front(std::move(entry));
 
         /* When the list is too long, start chopping */
         if (num_lines >= max_lines) {
-            num_lines -= entries.back().size;
-            entries.pop_back();
+            evict_back();
+        }
+        while (entries.back().removed) {
+            evict_back();
         }
 
         return entries.front();
     }
 
+    void evict_back()
+    {
+        auto& back = entries.back();
+        num_lines -= back.size;
+        scrollback_bytes -= back.accounted_bytes;
+        if (back.id)
+            entry_ids.erase(back.id);
+        if (back.removed)
+            num_removed--;
+        else
+            tally.lines_dropped++;
+        if (evicted.capacity() < evict_batch)
+            evicted.reserve(evict_batch);
+        evicted.push_back(std::move(back));
+        entries.pop_back();
+        if (evicted.size() == evict_batch)
+            reclaimer.dispose(std::exchange(evicted, decltype(evicted)(evicted.get_allocator())));
+    }
+
     // XXX: cleanup
     void on_set_clipboard_text()
     {
         std::u32string ret;
         const std::u32string sep(U"\n");
 
-        auto rects = get_highlighted_line_rects();
-        std::reverse(rects.begin(), rects.end());
-        for (auto entry_rit = entries.rbegin(); entry_rit != entries.rend(); ++entry_rit) {
-            auto& entry = *entry_rit;
-            if (!ret.empty())
-                ret += sep;
-
-            for (auto& line : entry.lines()) {
-                for (auto& rect : rects) {
-                    // std::cerr << "hirect: x=" << rect.x << ", y=" << rect.y << std::endl;
-                    // std::cerr << "linerect:" << to_utf8(line.text) << ", x=" << line.rect.x << ", y=" << line.rect.y << std::endl;
-                    auto col = get_column(rect.x);
-                    if (rect.y == line.coord.y && col < line.text.size()) {
-                        auto extent = column_extent(rect.w) + col;
-                        ret += line.text.substr(col, std::min(extent - col, line.text.size() - col));
-                    }
+        auto& highlighted = get_highlighted_line_rects();
+        std::pmr::vector<SDL_Rect> rects(highlighted.rbegin(), highlighted.rend(), &frame_arena());
+
+        // The selection is on screen, so only the lines drawn last frame
+        // are looked at, found as render_lines() does
+        struct Row {
+            LogEntry* entry;
+            WrappedLine* line;
+        };
+        std::pmr::vector<Row> shown(&frame_arena());
+        const int max_row = rows() + scroll_value;
+        int row_counter = 0;
+        visit_rows(prompt.entry, row_counter, max_row, [](WrappedLine&) {});
+        for (auto& entry : entries) {
+            if (row_counter > max_row)
+                break;
+            visit_rows(entry, row_counter, max_row, [&](WrappedLine& line) { shown.push_back({ &entry, &line }); });
+        }
+
+        LogEntry* last = nullptr;
+        for (auto row = shown.rbegin(); row != shown.rend(); ++row) {
+            if (row->entry != last) {
+                last = row->entry;
+                if (!ret.empty())
+                    ret += sep;
+            }
+
+            auto& line = *row->line;
+            for (auto& rect : rects) {
+                auto col = get_column(rect.x) + (line_wrap ? 0 : hscroll_value);
+                if (rect.y == line.coord.y && col < line.text.size()) {
+                    auto extent = column_extent(rect.w) + col;
+                    ret += line.text.substr(col, std::min(extent - col, line.text.size() - col));
                 }
             }
         }
@@ -1818,6 +4418,12 @@ struct LogScreen : public Widget {
         // SDL_RenderSetScale(renderer(), 1.2, 1.2);
         console::SDL_RenderSetViewport(renderer(), &viewport);
         prompt.maybe_rebuild();
+        if (screen_mode) {
+            render_screen();
+            console::SDL_RenderSetViewport(renderer(), &parent->viewport);
+            render_hud();
+            return;
+        }
         // TODO: make sure renderer supports blending else highlighting
         // will make the text invisible
         render_highlighted_lines();
@@ -1828,43 +4434,159 @@ struct LogScreen : public Widget {
         prompt.render_cursor(scroll_value);
         console::SDL_RenderSetViewport(renderer(), &parent->viewport);
         scrollbar.render();
+        hscrollbar.render();
+        render_hud();
         // SDL_RenderSetScale(renderer(), 1.0, 1.0);
     }
 
+    void render_hud()
+    {
+        if (!hud.visible)
+            return;
+        hud.viewport = viewport;
+        hud.render();
+    }
+
+    void render_screen()
+    {
+        screen.render(0, 0, font_color, bg_color);
+        rastering = false;
+
+        int ypos = viewport.h;
+        int row_counter = 0;
+        render_entry(prompt.entry, ypos, row_counter, rows());
+        batch.flush(renderer(), font->texture);
+        prompt.render_cursor(0);
+    }
+
     void render_lines()
     {
         const int max_row = rows() + scroll_value;
         int ypos = viewport.h;
         int row_counter = 0;
 
+        rastering = raster && raster->begin(renderer(), *font, columns(), rows());
         render_entry(prompt.entry, ypos, row_counter, max_row);
 
-        if (entries.empty())
-            return;
-
+        widest_row = 0;
         for (auto& entry : entries) {
-            render_entry(entry, ypos, row_counter, max_row);
+            if (row_counter > max_row)
+                break;
+            render_entry(entry, ypos, row_counter, max_row, hscroll_value);
         }
+        hscrollbar.set(hscroll_value, widest_row, columns());
+        if (rastering)
+            raster->present(renderer(), 0, raster_top());
+        else
+            batch.flush(renderer(), font->texture);
     }
 
-    void render_entry(LogEntry& entry, int& ypos, int& row_counter, const int max_row)
+    /* Draw text with SoftRaster instead of the renderer, or stop doing so. */
+    void set_software_raster(bool enable)
     {
-        // TODO: get rid of the reverse iterator
-        for (auto it = entry.lines().rbegin(); it != entry.lines().rend(); ++it) {
-            row_counter++;
-            if (row_counter <= scroll_value) {
-                continue;
-            } else if (row_counter > max_row) {
-                return;
-            }
+        if (enable && !raster)
+            raster = std::make_unique<SoftRaster>(pool);
+        else if (!enable)
+            raster.reset();
+    }
+
+    /* Lines are laid out from the bottom, the raster's rows are too. */
+    int raster_top()
+    {
+        return viewport.h - rows() * font->line_height;
+    }
 
-            auto& line = *it;
+    void render_entry(LogEntry& entry, int& ypos, int& row_counter, const int max_row, int first_column = 0)
+    {
+        visit_rows(entry, row_counter, max_row, [&](WrappedLine& line) {
             // ypos -= font->line_height * scale_factor
             ypos -= font->line_height;
             // record y position of this line
             // line.coord.y = ypos / scale_factor
             line.coord.y = ypos;
-            font->render(renderer(), line.text, line.coord.x, line.coord.y);
+            widest_row = std::max(widest_row, static_cast<int>(std::min<size_t>(line.text.length(), INT_MAX)));
+            queue_line(entry, line, first_column);
+        });
+    }
+
+    /*
+     * Call fn with each of the entry's lines that falls in the view, bottom
+     * up. Rows below the view are counted off without touching their lines,
+     * so only the chunks of a chunked entry that are seen get wrapped.
+     */
+    template <typename F>
+    void visit_rows(LogEntry& entry, int& row_counter, const int max_row, F&& fn)
+    {
+        const int size = static_cast<int>(entry.size);
+        const int skip = std::clamp(scroll_value - row_counter, 0, size);
+        row_counter += skip;
+        for (int k = skip; k < size; ++k) {
+            if (++row_counter > max_row)
+                return;
+            fn(entry.line(size - 1 - k));
+        }
+    }
+
+    /*
+     * Queue a line's glyphs, split into runs of equal attributes. Only the
+     * columns from first_column that fit the view are queued.
+     */
+    void queue_line(LogEntry& entry, WrappedLine& line, int first_column = 0)
+    {
+        const size_t first = std::min<size_t>(first_column, line.text.length());
+        const auto text = line.text.substr(first, columns());
+        if (entry.attrs.empty()) {
+            queue_run(text, line.coord.x, line.coord.y, font_color, {}, false);
+            return;
+        }
+
+        const int cw = font->char_width;
+        const size_t begin = line.start_index + first;
+        const size_t end = begin + text.length();
+        auto run = std::prev(std::upper_bound(entry.attrs.begin(), entry.attrs.end(), begin,
+            [](size_t i, const AttrRun& r) { return i < r.start; }));
+        for (size_t pos = begin; pos < end; ++run) {
+            size_t run_end = (run + 1 == entry.attrs.end()) ? end : std::min<size_t>(run[1].start, end);
+            if (run_end <= pos)
+                continue;
+
+            SDL_Color fg, bg;
+            resolve_colors(run->attr, fg, bg);
+            queue_run(text.substr(pos - begin, run_end - pos), line.coord.x + static_cast<int>(pos - begin) * cw,
+                line.coord.y, fg, bg, run->attr.flags & TextAttr::underline);
+            pos = run_end;
+        }
+    }
+
+    void queue_run(std::u32string_view text, int x, int y, const SDL_Color& fg, const SDL_Color& bg, bool underline)
+    {
+        const int lh = font->line_height;
+        if (rastering) {
+            raster->put((y - raster_top()) / lh, x / font->char_width, text, fg, bg, underline);
+            return;
+        }
+
+        SDL_Rect r = { x, y, static_cast<int>(text.length()) * font->char_width, lh };
+        if (bg.a)
+            batch.add_rect(r, bg);
+        if (underline)
+            batch.add_rect({ r.x, r.y + r.h - 2, r.w, 1 }, fg);
+        batch.add_text(*font, text, x, y, fg);
+    }
+
+    /* Colours to draw with. Background alpha is 0 when there is none. */
+    void resolve_colors(const TextAttr& attr, SDL_Color& fg, SDL_Color& bg)
+    {
+        fg = attr.fg.a ? attr.fg : font_color;
+        bg = attr.bg;
+        if (attr.flags & TextAttr::inverse) {
+            bg = fg;
+            fg = attr.bg.a ? attr.bg : bg_color;
+        }
+        if (attr.flags & TextAttr::bold) {
+            fg.r += (255 - fg.r) / 3;
+            fg.g += (255 - fg.g) / 3;
+            fg.b += (255 - fg.b) / 3;
         }
     }
 
@@ -1873,27 +4595,40 @@ struct LogScreen : public Widget {
         if (mouse_motion_end.y == -1)
             return;
 
-        auto rects = get_highlighted_line_rects();
+        auto& rects = get_highlighted_line_rects();
         if (rects.empty())
             return;
 
         set_draw_color(renderer(), colors::mediumgray);
-        for (auto& rect : rects) {
-
-            console::SDL_RenderFillRect(renderer(), &rect);
-        }
+        console::SDL_RenderFillRects(renderer(), rects.data(), static_cast<int>(rects.size()));
+        tally.draw_calls++;
         set_draw_color(renderer(), colors::darkgray);
     }
 
     // XXX: fix shimmering when going from bottom to top or right to left
     // XXX: cleanup
-    std::vector<SDL_Rect> get_highlighted_line_rects()
+    /* Cached until the selection, font or width changes. */
+    const std::vector<SDL_Rect>& get_highlighted_line_rects()
     {
         int char_width = font->char_width;
         int line_height = font->line_height;
         const SDL_Point& mouse_start = mouse_motion_start;
         const SDL_Point& mouse_end = mouse_motion_end;
 
+        auto& cache = highlight_cache;
+        if (cache.valid && cache.start.x == mouse_start.x && cache.start.y == mouse_start.y
+            && cache.end.x == mouse_end.x && cache.end.y == mouse_end.y
+            && cache.char_width == char_width && cache.line_height == line_height && cache.width == viewport.w)
+            return cache.rects;
+        cache.valid = true;
+        cache.start = mouse_start;
+        cache.end = mouse_end;
+        cache.char_width = char_width;
+        cache.line_height = line_height;
+        cache.width = viewport.w;
+        auto& rects = cache.rects;
+        rects.clear();
+
         // Calculate the start and end positions, snapping to line and character boundaries
         SDL_Rect srect;
         srect.x = std::min(mouse_start.x, mouse_end.x);
@@ -1914,7 +4649,6 @@ struct LogScreen : public Widget {
         SDL_Rect cur_rect = { start_x, srect.y, srect.w, line_height };
         int rows = srect.h / line_height;
 
-        std::vector<SDL_Rect> rects;
         rects.push_back(cur_rect);
         if (rows == 1)
             return rects;
@@ -1941,6 +4675,13 @@ struct LogScreen : public Widget {
         return rects;
     }
 
+    struct HighlightCache {
+        bool valid { false };
+        SDL_Point start, end;
+        int char_width, line_height, width;
+        std::vector<SDL_Rect> rects;
+    } highlight_cache;
+
     LogScreen(const LogScreen&) = delete;
     LogScreen& operator=(const LogScreen&) = delete;
 };
@@ -1949,6 +4690,9 @@ struct WindowContext {
     SDL_Window* handle;
     SDL_Renderer* renderer;
     SDL_Rect rect;
+    // Set by pick_renderer()
+    double glyph_rate { 0 };
+    bool software_raster { false };
 
     WindowContext(SDL_Window* h, SDL_Renderer* r, SDL_Rect re)
         : handle(h)
@@ -1958,20 +4702,138 @@ struct WindowContext {
     }
 };
 
+/*
+ * Glyph copies per second through a renderer, drawing tile_w x tile_h
+ * glyphs from a made up sheet into cells line_height apart. A pixel is
+ * read back at the end so a GPU has to finish the work. Returns 0 if the
+ * renderer can't do it.
+ */
+static double probe_glyph_rate(SDL_Renderer* renderer, int tile_w, int tile_h, int line_height)
+{
+    constexpr int count = 20000;
+    SDL_Texture* sheet = console::SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STATIC, tile_w * 16, tile_h * 16);
+    if (!sheet)
+        return 0;
+
+    std::vector<Uint32> pixels(tile_w * 16 * tile_h * 16);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = ((i * 2654435761u) & 0x80) ? 0xFFFFFFFF : 0;
+    console::SDL_UpdateTexture(sheet, nullptr, pixels.data(), tile_w * 16 * sizeof(Uint32));
+    console::SDL_SetTextureBlendMode(sheet, SDL_BLENDMODE_BLEND);
+
+    int w = 0, h = 0;
+    console::SDL_GetRendererOutputSize(renderer, &w, &h);
+    const int cols = std::max(1, w / tile_w);
+    const int rows = std::max(1, h / line_height);
+    auto draw = [&](int n) {
+        bool ok = true;
+        for (int i = 0; i < n; ++i) {
+            // Colour changes as often as a line of mixed attributes would
+            if (i % 64 == 0)
+                console::SDL_SetTextureColorMod(sheet, i & 0xFF, 255 - (i & 0xFF), 128);
+            SDL_Rect src = { (i % 16) * tile_w, (i / 16 % 16) * tile_h, tile_w, tile_h };
+            SDL_Rect dst = { (i % cols) * tile_w, (i / cols % rows) * line_height, tile_w, tile_h };
+            ok &= console::SDL_RenderCopy(renderer, sheet, &src, &dst) == 0;
+        }
+        Uint32 px;
+        SDL_Rect one = { 0, 0, 1, 1 };
+        console::SDL_RenderReadPixels(renderer, &one, SDL_PIXELFORMAT_ARGB8888, &px, sizeof(px));
+        return ok;
+    };
+
+    double rate = 0;
+    if (draw(1000)) { // warm up
+        auto start = std::chrono::steady_clock::now();
+        draw(count);
+        std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+        rate = secs.count() > 0 ? count / secs.count() : 0;
+    }
+    console::SDL_RenderClear(renderer);
+    console::SDL_DestroyTexture(sheet);
+    return rate;
+}
+
+/*
+ * Create the window's renderer as CONSOLE_HINT_RENDERER asks. Unless told
+ * to use only one kind, an accelerated renderer that can't be created falls
+ * back to the software one. "probe" times each kind, and CPU rasterization
+ * on the software one, with glyphs of the font to be used, and keeps the
+ * fastest.
+ */
+static SDL_Renderer* pick_renderer(SDL_Window* handle, int glyph_w, int glyph_h, int line_height,
+    double& glyph_rate, bool& software_raster)
+{
+    const char* hint = console::SDL_GetHint(CONSOLE_HINT_RENDERER);
+    const std::string mode = hint ? hint : "auto";
+    SDL_Renderer* renderer = nullptr;
+    glyph_rate = 0;
+    software_raster = false;
+
+    if (mode == "probe") {
+        ThreadPool pool(ThreadPool::default_size());
+        Uint32 best = 0;
+        for (Uint32 flags : { SDL_RENDERER_ACCELERATED, SDL_RENDERER_SOFTWARE }) {
+            // A window has one renderer at a time
+            SDL_Renderer* r = console::SDL_CreateRenderer(handle, -1, flags);
+            if (!r)
+                continue;
+            double rate = probe_glyph_rate(r, glyph_w, glyph_h, line_height);
+            bool raster = false;
+            if (flags == SDL_RENDERER_SOFTWARE) {
+                double cpu = SoftRaster::probe_rate(r, pool, glyph_w, glyph_h, line_height);
+                if (cpu > rate) {
+                    rate = cpu;
+                    raster = true;
+                }
+            }
+            console::SDL_DestroyRenderer(r);
+            if (rate > glyph_rate) {
+                glyph_rate = rate;
+                software_raster = raster;
+                best = flags;
+            }
+        }
+        if (best)
+            renderer = console::SDL_CreateRenderer(handle, -1, best);
+        if (renderer)
+            return renderer;
+        glyph_rate = 0;
+        software_raster = false;
+    }
+
+    if (mode != "software")
+        renderer = console::SDL_CreateRenderer(handle, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer && mode != "accelerated")
+        renderer = console::SDL_CreateRenderer(handle, -1, SDL_RENDERER_SOFTWARE);
+
+    // SDL_HINT_RENDER_DRIVER can also pick the software renderer
+    SDL_RendererInfo info;
+    if (renderer && console::SDL_GetRendererInfo(renderer, &info) == 0)
+        software_raster = info.flags & SDL_RENDERER_SOFTWARE;
+    return renderer;
+}
+
 struct MainWindow : public Widget {
     WidgetContext widget_context;
     SDL_Window* handle { nullptr };
     SDL_Point mouse_coord {}; // stores mouse position relative to window
     std::unique_ptr<Toolbar> toolbar; // optional toolbar. XXX: implementation requires it
+    StatusBar status_bar;
     LogScreen log_screen;
     Uint32 window_id; // Window id from SDL
+    // Renderer in use, as reported by Console_GetStats()
+    std::string backend;
+    double glyph_rate { 0 };
     void render() {};
 
     MainWindow(WindowContext winctx, Font* font, EventEmitter& emitter)
         : Widget(font, widget_context, winctx.rect)
         , widget_context(winctx.renderer, &emitter, mouse_coord)
         , handle(winctx.handle)
+        , status_bar(this)
         , log_screen(this)
+        , glyph_rate(winctx.glyph_rate)
     {
         window_id = console::SDL_GetWindowID(handle);
         if (window_id == 0)
@@ -1991,10 +4853,25 @@ struct MainWindow : public Widget {
         console::SDL_SetWindowMinimumSize(handle, 64, 48);
         console::SDL_RenderSetIntegerScale(renderer(), SDL_TRUE);
 
+        SDL_RendererInfo info;
+        if (console::SDL_GetRendererInfo(renderer(), &info) == 0 && info.name)
+            backend = info.name;
+        // Per-glyph copies are slow without a GPU, draw text on the CPU instead
+        log_screen.set_software_raster(winctx.software_raster);
+
         toolbar = std::make_unique<Toolbar>(this);
 
         toolbar->set_viewport({ 0, 0, viewport.w, font->line_height * 2 });
-        log_screen.set_viewport({ 0, toolbar->viewport.h, viewport.w, viewport.h });
+        layout();
+    }
+
+    /* Stack the status line and log screen below the toolbar. */
+    void layout()
+    {
+        int y = toolbar->viewport.h;
+        status_bar.set_viewport({ 0, y, viewport.w, status_bar.height() });
+        y += status_bar.viewport.h;
+        log_screen.set_viewport({ 0, y, viewport.w, viewport.h });
     }
 
     ~MainWindow()
@@ -2012,6 +4889,7 @@ struct MainWindow : public Widget {
         console::SDL_GetRendererOutputSize(renderer(), &viewport.w, &viewport.h);
         console::SDL_RenderSetViewport(renderer(), &viewport);
         toolbar->on_resize();
+        status_bar.viewport.w = viewport.w;
         log_screen.on_resize();
     }
 
@@ -2022,7 +4900,10 @@ struct MainWindow : public Widget {
             throw std::runtime_error("Failed to create SDL window");
         }
 
-        SDL_Renderer* renderer = console::SDL_CreateRenderer(handle, -1, SDL_RENDERER_ACCELERATED);
+        double glyph_rate;
+        bool software_raster;
+        SDL_Renderer* renderer = pick_renderer(handle, BMPFontLoader::glyph_w, BMPFontLoader::glyph_h,
+            BMPFontLoader::glyph_h + Font::default_line_space, glyph_rate, software_raster);
         if (!renderer) {
             console::SDL_DestroyWindow(handle);
             throw std::runtime_error("Failed to create SDL renderer");
@@ -2030,7 +4911,10 @@ struct MainWindow : public Widget {
 
         SDL_Rect rect = {};
         console::SDL_GetRendererOutputSize(renderer, &rect.w, &rect.h);
-        return WindowContext(handle, renderer, rect);
+        WindowContext wctx(handle, renderer, rect);
+        wctx.glyph_rate = glyph_rate;
+        wctx.software_raster = software_raster;
+        return wctx;
     }
 
     MainWindow(const MainWindow&) = delete;
@@ -2095,104 +4979,610 @@ int Toolbar::compute_widgets_startx()
     return x;
 }
 
+/* An SDL event and when on_sdl_event() received it. */
+struct QueuedEvent {
+    SDL_Event event;
+    Clock::time_point received;
+};
+
+/*
+ * Fold a mouse motion into the motion queued before it. Only the latest
+ * position matters to the handlers; relative motion is summed.
+ */
+static bool merge_motion(QueuedEvent& last, const QueuedEvent& e)
+{
+    auto& a = last.event.motion;
+    auto& b = e.event.motion;
+    if (e.event.type != SDL_MOUSEMOTION || last.event.type != SDL_MOUSEMOTION
+        || a.windowID != b.windowID || a.state != b.state)
+        return false;
+
+    int xrel = a.xrel + b.xrel;
+    int yrel = a.yrel + b.yrel;
+    a = b;
+    a.xrel = xrel;
+    a.yrel = yrel;
+    return true;
+}
+
 class ExternalEventWaiter {
     using Notifier = std::atomic<bool>;
     template <typename T>
     class EventQueue {
         friend class ExternalEventWaiter;
 
-    public:
-        EventQueue(Notifier& notifier, State& status)
-            : notifier(notifier)
-            , status(status)
-        {
-        }
+    public:
+        EventQueue(Notifier& notifier, State& status, std::pmr::memory_resource* memory)
+            : memory(memory)
+            , notifier(notifier)
+            , status(status)
+        {
+        }
+
+        void push(T event)
+        {
+            {
+                std::scoped_lock lock(mutex);
+                if (status != State::active)
+                    return;
+                create();
+                queue->push(std::move(event));
+                note_size();
+                ++pushed;
+                notifier = true;
+            }
+            notifier.notify_one();
+        }
+
+        /*
+         * Like push(), but before() is called first under the queue's lock,
+         * so whatever it numbers is numbered in queue order. Returns a
+         * ticket for append_last(), 0 if event wasn't queued.
+         */
+        template <typename Before>
+        Uint64 push(T event, Before before)
+        {
+            Uint64 ticket;
+            {
+                std::scoped_lock lock(mutex);
+                before();
+                if (status != State::active)
+                    return 0;
+                create();
+                queue->push(std::move(event));
+                note_size();
+                ticket = ++pushed;
+                notifier = true;
+            }
+            notifier.notify_one();
+            return ticket;
+        }
+
+        /*
+         * Call append() under the queue's lock if the item pushed with ticket
+         * is still the newest, so what it adds to that item stays in queue
+         * order. Returns what append() does, or false.
+         */
+        template <typename Append>
+        bool append_last(Uint64 ticket, Append append)
+        {
+            std::scoped_lock lock(mutex);
+            if (!ticket || ticket != pushed || status != State::active)
+                return false;
+            return append();
+        }
+
+        /*
+         * Like push(), but merge(last, event) may first fold event into the
+         * last queued item. Returns true if it did.
+         */
+        template <typename Merge>
+        bool push_merging(T event, Merge merge)
+        {
+            {
+                std::scoped_lock lock(mutex);
+                if (status != State::active)
+                    return false;
+                create();
+                if (!queue->empty() && merge(queue->back(), event))
+                    return true;
+                queue->push(std::move(event));
+                note_size();
+                ++pushed;
+                notifier = true;
+            }
+            notifier.notify_one();
+            return false;
+        }
+
+        bool pop(T& event)
+        {
+            std::scoped_lock lock(mutex);
+            if (queue && !queue->empty()) {
+                event = std::move(queue->front());
+                queue->pop();
+                size_ = queue->size();
+                return true;
+            }
+            return false;
+        }
+
+        /* Items queued now, and the most there have been. */
+        size_t size() const
+        {
+            return size_;
+        }
+
+        size_t high_water() const
+        {
+            return high_water_;
+        }
+
+    protected:
+        std::mutex mutex;
+
+    private:
+        void note_size()
+        {
+            size_ = queue->size();
+            if (size_ > high_water_)
+                high_water_ = size_.load();
+        }
+
+        // An empty deque allocates, and the consoles are static; made on
+        // the first push so Console_SetAllocator() can come before it.
+        void create()
+        {
+            if (!queue)
+                queue.emplace(std::pmr::deque<T>(memory));
+        }
+
+        std::pmr::memory_resource* memory;
+        std::optional<std::queue<T, std::pmr::deque<T>>> queue;
+        Uint64 pushed { 0 }; // items ever queued, under mutex
+        std::atomic<size_t> size_ { 0 };
+        std::atomic<size_t> high_water_ { 0 };
+        Notifier& notifier;
+        State& status;
+    };
+
+public:
+    ExternalEventWaiter()
+        : sdl(notifier, status, memory::account(CONSOLE_MEMORY_SDL_QUEUE))
+        , api(notifier, status, memory::account(CONSOLE_MEMORY_API_QUEUE))
+    {
+    }
+
+    void wait_for_events()
+    {
+        notifier.wait(false);
+        {
+            /* synchronize to ensure we don't miss any events */
+            std::scoped_lock lock(sdl.mutex, api.mutex);
+            notifier = false;
+        }
+    }
+
+    /* Wake the render thread without queuing anything. */
+    void wake()
+    {
+        notifier = true;
+        notifier.notify_one();
+    }
+
+    void drain()
+    {
+        QueuedEvent e;
+        while (sdl.pop(e))
+            ;
+        Task t;
+        while (api.pop(t))
+            ;
+    }
+
+    void reset()
+    {
+        drain();
+        std::scoped_lock lock(sdl.mutex, api.mutex);
+        status = State::active;
+    }
+
+    void shutdown()
+    {
+        {
+            std::scoped_lock lock(sdl.mutex, api.mutex);
+            status = State::shutdown;
+        }
+        drain();
+    }
+
+    ExternalEventWaiter(const ExternalEventWaiter&) = delete;
+    ExternalEventWaiter& operator=(const ExternalEventWaiter&) = delete;
+
+    EventQueue<QueuedEvent> sdl;
+    using Task = std::function<void()>;
+    EventQueue<Task> api;
+
+private:
+    Notifier notifier { false };
+    State status = { State::active };
+};
+
+/*
+ * Log-linear histogram of microseconds: four buckets per power of two,
+ * so percentiles are within about 20%. The maximum is exact.
+ */
+struct LatencyHistogram {
+    void add(Uint64 us)
+    {
+        counts[bucket(us)]++;
+        count++;
+        max = std::max(max, us);
+    }
+
+    /* Upper bound of the bucket holding the q quantile, 0 < q <= 1. */
+    Uint64 percentile(double q) const
+    {
+        Uint64 target = std::max<Uint64>(1, static_cast<Uint64>(std::ceil(q * count)));
+        Uint64 seen = 0;
+        for (size_t b = 0; b < counts.size(); ++b) {
+            seen += counts[b];
+            if (seen >= target)
+                return std::min(upper_bound(b), max);
+        }
+        return max;
+    }
+
+    std::array<Uint64, 256> counts {};
+    Uint64 count { 0 };
+    Uint64 max { 0 };
+
+private:
+    static size_t bucket(Uint64 v)
+    {
+        if (v < 4)
+            return v;
+        int msb = std::bit_width(v) - 1;
+        return (msb - 1) * 4 + ((v >> (msb - 2)) & 3);
+    }
+
+    static Uint64 upper_bound(size_t b)
+    {
+        if (b < 4)
+            return b;
+        int msb = b / 4 + 1;
+        Uint64 step = Uint64(1) << (msb - 2);
+        return (4 + b % 4) * step + step - 1;
+    }
+};
+
+/*
+ * Follows key presses and text input from on_sdl_event() through the
+ * event queue, their handlers and the next frame, to the end of the
+ * SDL_RenderPresent() that first shows them. Stamps are taken on the render
+ * thread; the histograms are also read by Console_GetLatencyStats(), so
+ * they are only touched under the lock.
+ */
+class LatencyTracer {
+public:
+    static bool traced(const SDL_Event& e)
+    {
+        return e.type == SDL_KEYDOWN || e.type == SDL_TEXTINPUT;
+    }
+
+    /* A traced event was taken off the queue and its handlers have run. */
+    void dispatched(Clock::time_point received, Clock::time_point dequeued)
+    {
+        pending.push_back({ received, dequeued, Clock::now() });
+    }
+
+    /* Start of a frame, before the prompt is rebuilt. */
+    void frame_started()
+    {
+        frame_start = Clock::now();
+    }
+
+    void presented()
+    {
+        if (pending.empty())
+            return;
+        auto now = Clock::now();
+        std::scoped_lock lock(mutex);
+        for (auto& p : pending) {
+            total.add(micros(now - p.received));
+            queue.add(micros(p.dequeued - p.received));
+            dispatch.add(micros(p.dispatched - p.dequeued));
+            frame_wait.add(micros(frame_start - p.dispatched));
+            render.add(micros(now - frame_start));
+        }
+        pending.clear();
+    }
+
+    void get(Console_LatencyStats& stats)
+    {
+        std::scoped_lock lock(mutex);
+        stats.count = total.count;
+        stats.p50_us = total.percentile(0.5);
+        stats.p99_us = total.percentile(0.99);
+        stats.max_us = total.max;
+        stats.queue_p50_us = queue.percentile(0.5);
+        stats.dispatch_p50_us = dispatch.percentile(0.5);
+        stats.frame_wait_p50_us = frame_wait.percentile(0.5);
+        stats.render_p50_us = render.percentile(0.5);
+    }
+
+    void reset()
+    {
+        std::scoped_lock lock(mutex);
+        total = queue = dispatch = frame_wait = render = {};
+    }
+
+    /* Draw the totals at the top right of area. */
+    void render_overlay(SDL_Renderer* renderer, Font& font, const SDL_Rect& area)
+    {
+        Console_LatencyStats stats;
+        get(stats);
+        char buf[96];
+        int n = std::snprintf(buf, sizeof(buf), "latency p50 %.1fms p99 %.1fms max %.1fms (%llu)",
+            stats.p50_us / 1000, stats.p99_us / 1000, stats.max_us / 1000, stats.count);
+        std::u32string text(buf, buf + std::clamp(n, 0, static_cast<int>(sizeof(buf)) - 1));
+
+        SDL_Rect r = { area.x + area.w - static_cast<int>(text.length()) * font.char_width - font.char_width,
+            area.y, static_cast<int>(text.length()) * font.char_width, font.line_height };
+        set_draw_color(renderer, colors::charcoal);
+        console::SDL_RenderFillRect(renderer, &r);
+        set_draw_color(renderer, colors::darkgray);
+        console::SDL_SetTextureColorMod(font.texture, 255, 255, 0);
+        font.render(renderer, text, r.x, r.y);
+        console::SDL_SetTextureColorMod(font.texture, 255, 255, 255);
+    }
+
+    bool overlay { false };
+
+private:
+    struct Pending {
+        Clock::time_point received;
+        Clock::time_point dequeued;
+        Clock::time_point dispatched;
+    };
+
+    static Uint64 micros(Clock::duration d)
+    {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        return us > 0 ? us : 0;
+    }
+
+    std::vector<Pending> pending; // dispatched, not yet presented
+    Clock::time_point frame_start;
+    std::mutex mutex;
+    LatencyHistogram total;
+    LatencyHistogram queue;
+    LatencyHistogram dispatch;
+    LatencyHistogram frame_wait;
+    LatencyHistogram render;
+};
+
+/*
+ * Prefix trie over command names, used for dispatch and tab completion.
+ * Nodes live in one vector and are linked first-child/next-sibling, with
+ * siblings kept sorted so completions are listed in order.
+ */
+class CommandTrie {
+public:
+    CommandTrie()
+    {
+        nodes.emplace_back(); // root
+    }
+
+    bool insert(std::u32string_view name, int command)
+    {
+        uint32_t n = 0;
+        for (auto ch : name) {
+            uint32_t prev = 0;
+            uint32_t c = nodes[n].child;
+            while (c && nodes[c].ch < ch) {
+                prev = c;
+                c = nodes[c].sibling;
+            }
+            if (!c || nodes[c].ch != ch) {
+                uint32_t idx = nodes.size();
+                nodes.push_back({ ch, 0, c, -1 });
+                if (prev)
+                    nodes[prev].sibling = idx;
+                else
+                    nodes[n].child = idx;
+                c = idx;
+            }
+            n = c;
+        }
+        if (nodes[n].command >= 0)
+            return false;
+        nodes[n].command = command;
+        return true;
+    }
+
+    /* Returns the command index, or -1 */
+    int find(std::u32string_view name) const
+    {
+        uint32_t n;
+        return descend(name, n) ? nodes[n].command : -1;
+    }
+
+    /*
+     * Collect the commands starting with prefix into matches and return
+     * the longest extension of prefix they all share.
+     */
+    std::u32string complete(std::u32string_view prefix, std::vector<int>& matches) const
+    {
+        uint32_t n;
+        std::u32string ext;
+        if (!descend(prefix, n))
+            return ext;
 
-        void push(T event)
-        {
-            {
-                std::scoped_lock lock(mutex);
-                if (status != State::active)
-                    return;
-                queue.push(event);
-                notifier = true;
-            }
-            notifier.notify_one();
+        collect(n, matches);
+        while (nodes[n].command < 0 && nodes[n].child && !nodes[nodes[n].child].sibling) {
+            n = nodes[n].child;
+            ext += nodes[n].ch;
         }
+        return ext;
+    }
 
-        bool pop(T& event)
-        {
-            std::scoped_lock lock(mutex);
-            if (!queue.empty()) {
-                event = queue.front();
-                queue.pop();
-                return true;
-            }
-            return false;
+private:
+    struct Node {
+        char32_t ch { 0 };
+        uint32_t child { 0 }; // 0 = none, root is never a child
+        uint32_t sibling { 0 };
+        int command { -1 };
+    };
+
+    bool descend(std::u32string_view s, uint32_t& n) const
+    {
+        n = 0;
+        for (auto ch : s) {
+            uint32_t c = nodes[n].child;
+            while (c && nodes[c].ch != ch)
+                c = nodes[c].sibling;
+            if (!c)
+                return false;
+            n = c;
         }
+        return true;
+    }
 
-    protected:
-        std::mutex mutex;
+    void collect(uint32_t n, std::vector<int>& out) const
+    {
+        if (nodes[n].command >= 0)
+            out.push_back(nodes[n].command);
+        for (uint32_t c = nodes[n].child; c; c = nodes[c].sibling)
+            collect(c, out);
+    }
 
-    private:
-        std::queue<T> queue;
-        Notifier& notifier;
-        State& status;
-    };
+    std::vector<Node> nodes;
+};
+
+void run_command(Console_con* con, Console_CommandHandler handler, const char* args);
 
+/*
+ * Commands registered through Console_RegisterCommand(). Lookups happen on
+ * the render thread; registration and lookup are serialized by the console
+ * mutex.
+ */
+class CommandRegistry {
 public:
-    ExternalEventWaiter()
-        : sdl(notifier, status)
-        , api(notifier, status)
+    CommandRegistry()
+        : pool(2)
     {
     }
 
-    void wait_for_events()
+    bool add(const std::u32string& name, Console_CommandHandler handler, int flags)
     {
-        notifier.wait(false);
-        {
-            /* synchronize to ensure we don't miss any events */
-            std::scoped_lock lock(sdl.mutex, api.mutex);
-            notifier = false;
+        if (name.empty() || name.find_first_of(U" \t\n\r") != std::u32string::npos)
+            return false;
+        if (!trie.insert(name, commands.size()))
+            return false;
+        commands.push_back({ name, handler, flags });
+        return true;
+    }
+
+    /* Returns false if the line doesn't start with a registered command. */
+    bool dispatch(Console_con* con, std::u32string_view line)
+    {
+        if (commands.empty())
+            return false;
+
+        const char32_t* ws = U" \t";
+        auto name_start = line.find_first_not_of(ws);
+        if (name_start == std::u32string::npos)
+            return false;
+        auto name_end = line.find_first_of(ws, name_start);
+        auto idx = trie.find(std::u32string_view(line).substr(name_start, name_end - name_start));
+        if (idx < 0)
+            return false;
+
+        auto& cmd = commands[idx];
+        std::string args;
+        if (name_end != std::u32string::npos) {
+            auto args_start = line.find_first_not_of(ws, name_end);
+            if (args_start != std::u32string::npos)
+                args = to_utf8(std::u32string(line.substr(args_start)));
+        }
+
+        if (cmd.flags & CONSOLE_COMMAND_RENDER_THREAD) {
+            deferred.push_back({ cmd.handler, std::move(args) });
+        } else {
+            pool.submit([con, handler = cmd.handler, args = std::move(args)] {
+                run_command(con, handler, args.c_str());
+            });
         }
+        return true;
     }
 
-    void drain()
+    /*
+     * Complete the command name being typed. An ambiguous prefix is
+     * extended as far as possible, or the candidates are listed.
+     */
+    void complete(Prompt& prompt, LogScreen& screen)
     {
-        SDL_Event e;
-        while (sdl.pop(e))
-            ;
-        Task t;
-        while (api.pop(t))
-            ;
+        auto& input = *prompt.input;
+        if (prompt.cursor != input.length() || input.find_first_of(U" \t") != std::u32string::npos)
+            return;
+
+        std::vector<int> matches;
+        auto ext = trie.complete(input, matches);
+        if (matches.empty())
+            return;
+
+        if (matches.size() == 1) {
+            prompt.add_input(ext + U" ");
+        } else if (!ext.empty()) {
+            prompt.add_input(ext);
+        } else {
+            std::u32string list;
+            for (auto i : matches) {
+                if (!list.empty())
+                    list += U"  ";
+                list += commands[i].name;
+            }
+            screen.on_new_output_line(list);
+        }
     }
 
-    void reset()
+    /*
+     * Run the render thread commands dispatched since the last call. Called
+     * with the console mutex released, so handlers may use the API.
+     */
+    void run_deferred(Console_con* con)
     {
-        drain();
-        std::scoped_lock lock(sdl.mutex, api.mutex);
-        status = State::active;
+        if (deferred.empty())
+            return;
+        auto ready = std::move(deferred);
+        deferred.clear();
+        for (auto& [handler, args] : ready)
+            handler(con, args.c_str());
     }
 
     void shutdown()
     {
-        {
-            std::scoped_lock lock(sdl.mutex, api.mutex);
-            status = State::shutdown;
-        }
-        drain();
+        pool.shutdown();
     }
 
-    ExternalEventWaiter(const ExternalEventWaiter&) = delete;
-    ExternalEventWaiter& operator=(const ExternalEventWaiter&) = delete;
-
-    EventQueue<SDL_Event> sdl;
-    using Task = std::function<void()>;
-    EventQueue<Task> api;
+    CommandRegistry(const CommandRegistry&) = delete;
+    CommandRegistry& operator=(const CommandRegistry&) = delete;
 
 private:
-    Notifier notifier { false };
-    State status = { State::active };
+    struct Command {
+        std::u32string name;
+        Console_CommandHandler handler;
+        int flags;
+    };
+
+    CommandTrie trie;
+    std::vector<Command> commands;
+    // CONSOLE_COMMAND_RENDER_THREAD handlers waiting for the mutex to be
+    // released, with their arguments. Render thread only.
+    std::vector<std::pair<Console_CommandHandler, std::string>> deferred;
+    // Runs handlers so that long commands don't stall input and rendering.
+    ThreadPool pool;
 };
 
 bool in_rect(int x, int y, SDL_Rect& r)
@@ -2218,70 +5608,43 @@ int set_draw_color(SDL_Renderer* renderer, const SDL_Color& color)
     return console::SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
 }
 
+/*
+ * Break entry.text into lines no wider than width pixels, at the last
+ * whitespace if there is one. Touches nothing but the entry, so entries
+ * can be wrapped on any thread.
+ */
+void wrap_entry(LogEntry& entry, int width, int advance)
+{
+    // A character is wrapped once (length + 1) * advance >= width, which
+    // is length + 1 >= columns. Columns of 0 and 1 behave the same.
+    int columns = width <= 0 ? 1 : advance > 0 ? (width - 1) / advance + 1 : INT_MAX;
+    if (entry.chunkable && entry.text.length() > LogEntry::chunk_threshold) {
+        entry.wrap_chunked(columns);
+        return;
+    }
+    if (entry.use_layout(columns))
+        return;
+
+    LineBreaker walk { entry.text, entry.breaks.data(), entry.breaks.size(), static_cast<size_t>(columns) };
+    for (size_t start, end; walk.next(start, end);)
+        entry.add_line(std::u32string_view(entry.text).substr(start, end - start), start, end);
+}
+
 // Used by Prompt and LogScreen
-// XXX: cleanup.
 void make_logentry_lines(
     Widget& widget,
     LogEntry& entry,
-    std::u32string& text)
+    std::u32string_view text)
 {
-    struct Segment {
-        size_t start;
-        size_t end;
-    };
-
-    entry.clear();
-    entry.text = text;
-    // Break up the text into line segments, if needed
-    int advance = widget.font->char_width;
-    int delim_idx = 0; // last whitespace character for wrapping on word boundaries
-    int start_idx = 0;
-    int end_idx = 0;
-    std::vector<Segment> segments;
-    for (auto& ch : text) {
-        if (ch == U'\n' || ch == U'\r') {
-            // Not including the new line character
-            // Don't attempt to add an empty segment
-            if (end_idx - start_idx > 0)
-                segments.emplace_back(start_idx, end_idx);
-            start_idx = end_idx + 1;
-            delim_idx = 0;
-            // TODO: check for spaces properly?
-        } else if (ch == U' ' || ch == U'\t') {
-            delim_idx = end_idx;
-            // check if width exceeded
-        } else if (((end_idx - start_idx + 1) * advance) >= widget.viewport.w) {
-            if (delim_idx) {
-                // wrap at last whitespace
-                segments.emplace_back(start_idx, delim_idx + 1);
-                start_idx = delim_idx + 1;
-            } else {
-                // wrap at last character
-                segments.emplace_back(start_idx, end_idx + 1);
-                start_idx = end_idx + 1;
-            }
-            delim_idx = 0;
-        }
-
-        end_idx++;
-    }
-    //  Handle any remaining text
-    if (end_idx > start_idx) {
-        // second idx = -1
-        segments.emplace_back(start_idx, std::u32string::npos);
-    }
-
-    for (auto& seg : segments) {
-        if (seg.end - seg.start == 0) {
-            // XXX: Sanity check.
-            // std:cerr << "attempt to use empty segment" << endl;
-            continue;
-        }
-        // std::cerr << "Adding line segment: " << idx_pair.first << "," << idx_pair.second << std::endl;
-        // std::u32string str = text.substr(seg.start, seg.end - seg.start);
-        auto v = std::u32string_view(entry.text).substr(seg.start, seg.end - seg.start);
-        entry.add_line(v, seg.start, seg.end);
-    }
+    CONSOLE_TRACE_SCOPE("make_logentry_lines");
+    auto wrap_start = Clock::now();
+    if (text.data() != entry.text.data()) {
+        entry.text = text;
+        entry.index_breaks();
+    }
+    wrap_entry(entry, widget.wrap_width(), widget.font->char_width);
+    tally.wraps++;
+    tally.wrap_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - wrap_start).count();
 }
 // TODO: handle errors properly.  TODO: TTF not currently used, needs reworked to support font atlas.
 #if 0
@@ -2346,6 +5709,73 @@ private:
     void* saved_user_data { nullptr };
 };
 
+namespace console {
+/*
+ * Lines added by a command are collected into a batch which is queued as a
+ * single API task. The batch accepts more lines until the render thread
+ * takes it or anything else is queued after it, which keeps ordering.
+ */
+struct OutputBatch {
+    std::mutex mutex;
+    bool taken { false };
+    std::vector<std::pair<Console_LineId, LogEntry>> lines;
+    Uint64 ticket { 0 }; // from EventQueue::push()
+};
+// Set while a command handler runs on this thread.
+thread_local Console_con* command_con = nullptr;
+thread_local std::shared_ptr<OutputBatch> command_output;
+}
+
+/*
+ * Backs Console_GetStats(). Counters are atomics updated by whichever
+ * thread does the work, so any thread can read them; together they're not
+ * a consistent snapshot. The render thread's counts are moved in from
+ * its RenderTally once a frame.
+ */
+struct Counters {
+    std::atomic<Uint64> lines_ingested { 0 };
+    std::atomic<Uint64> bytes_ingested { 0 };
+    std::atomic<Uint64> lines_dropped { 0 };
+    std::atomic<Uint64> sdl_events_received { 0 };
+    std::atomic<Uint64> sdl_events_coalesced { 0 };
+    std::atomic<Uint64> wraps { 0 };
+    std::atomic<Uint64> wrap_ns { 0 };
+    std::atomic<Uint64> frames_rendered { 0 };
+    std::atomic<Uint64> frames_skipped { 0 };
+    std::atomic<Uint64> glyphs_last_frame { 0 };
+    std::atomic<Uint64> draw_calls_last_frame { 0 };
+    std::atomic<Uint64> scrollback_bytes { 0 };
+    std::atomic<Uint64> last_line_presented { 0 };
+    // Microseconds from the start of a frame to its present
+    std::mutex frame_time_mutex;
+    LatencyHistogram frame_time;
+
+    void ingested(const char* s, Uint64 lines)
+    {
+        lines_ingested += lines;
+        bytes_ingested += std::strlen(s);
+    }
+
+    /* Take the render thread's counts. Per frame counts need drawn set. */
+    void publish(RenderTally& t, bool drawn)
+    {
+        wraps += t.wraps;
+        wrap_ns += t.wrap_ns;
+        lines_dropped += t.lines_dropped;
+        if (drawn) {
+            glyphs_last_frame = t.glyphs;
+            draw_calls_last_frame = t.draw_calls;
+        }
+        t = {};
+    }
+
+    void add_frame_time(Clock::duration d)
+    {
+        std::scoped_lock lock(frame_time_mutex);
+        frame_time.add(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+};
+
 struct Console_con {
     struct Impl {
         // For internal communication, mainly by widgets.
@@ -2355,29 +5785,44 @@ struct Console_con {
         // A new Font object may be used when
         // changing font size.
         std::unique_ptr<FontLoader> font_loader;
-        SDL_Color bg_color; // not currently used
-        SDL_Color font_color; // not currently used
         // Used by GetLine() to wait for a new input line event.
         InputLineWaiter input_line_waiter;
         ExternalEventWaiter& external_event_waiter;
+        // Written by Console_SetStatus(), sampled once per frame.
+        StatusSlots& status_slots;
+        Counters& counters;
         // Event Filter is how we currently receive events from SDL.
         SDLEventFilterSetter event_filter_setter;
         // Stores the thread id of the thread used to create the console, which is also
         // the thread responsible for rendering.
         std::thread::id render_thread_id;
+        LatencyTracer latency;
+
+        // Registered commands. Kept last so the worker pool is joined
+        // before anything its handlers might touch is destroyed.
+        CommandRegistry commands;
 
-        Impl(Console_con* con, WindowContext wctx, std::unique_ptr<FontLoader> fl, ExternalEventWaiter& external_event_waiter)
+        Impl(Console_con* con, WindowContext wctx, std::unique_ptr<FontLoader> fl, ExternalEventWaiter& external_event_waiter, StatusSlots& status_slots, Counters& counters)
             : window(wctx, fl->get_font(), internal_emitter)
             , font_loader(std::move(fl))
-            , input_line_waiter(internal_emitter)
             , external_event_waiter(external_event_waiter)
+            , status_slots(status_slots)
+            , counters(counters)
             , event_filter_setter(on_sdl_event, con)
             , render_thread_id(std::this_thread::get_id())
         {
             external_event_waiter.reset();
             console::SDL_StartTextInput();
-            window.log_screen.connect(InternalEventType::new_input_line, [this](SDL_Event& e) {
-                input_line_waiter.push(std::u32string(U"test"));
+            internal_emitter.connect(InternalEventType::new_input_line, [this, con](SDL_Event& e) {
+                auto* str = static_cast<std::pmr::u32string*>(e.user.data1);
+                if (str == nullptr) {
+                    input_line_waiter.push(U"");
+                } else if (!commands.dispatch(con, *str)) {
+                    input_line_waiter.push(std::u32string(*str));
+                }
+            });
+            internal_emitter.connect(InternalEventType::complete_input, [this](SDL_Event& e) {
+                commands.complete(*static_cast<Prompt*>(e.user.data1), window.log_screen);
             });
         };
 
@@ -2392,7 +5837,7 @@ struct Console_con {
 
     void init(WindowContext wctx, std::unique_ptr<FontLoader> fl)
     {
-        impl = std::make_unique<Impl>(this, wctx, std::move(fl), external_event_waiter);
+        impl = std::make_unique<Impl>(this, wctx, std::move(fl), external_event_waiter, status_slots, counters);
     }
 
     bool is_active()
@@ -2410,6 +5855,28 @@ struct Console_con {
         return impl->window.log_screen;
     }
 
+    /* Queue an API task to run on the render thread. */
+    void push_task(ExternalEventWaiter::Task task)
+    {
+        // Output queued by a command after this task must not be
+        // merged into a batch that runs before it.
+        command_output.reset();
+        external_event_waiter.api.push(std::move(task));
+    }
+
+    /*
+     * Queue a task adding count lines, taking their ids as it's queued so
+     * tasks run in id order. Returns the first id.
+     */
+    Console_LineId push_lines(ExternalEventWaiter::Task task, Console_LineId& first, size_t count)
+    {
+        command_output.reset();
+        external_event_waiter.api.push(std::move(task), [&] {
+            first = next_line_id.fetch_add(count);
+        });
+        return first;
+    }
+
     /* Queues SDL events and API tasks to later run on the render thread.
      * SDL events should be drained from it on shutdown.
      * API tasks should be drained as well, but just in case
@@ -2417,7 +5884,14 @@ struct Console_con {
      * and instruct the queues not to accept more items.
      */
     ExternalEventWaiter external_event_waiter;
+    // Outlives impl so Console_SetStatus() never races its destruction.
+    StatusSlots status_slots;
+    Counters counters;
     std::atomic<State> status { State::active };
+    std::atomic<Console_LineId> next_line_id { 1 };
+    // Read by the threads adding lines; LogScreen has its own copy for
+    // lines updated on the render thread
+    std::atomic<bool> overwrite_on_cr { false };
     std::unique_ptr<Impl> impl;
     // Protects access to data such as rows() and column()
     // information fetched from API functions.
@@ -2434,27 +5908,116 @@ namespace console {
 int render_frame(Console_con::Impl* impl)
 {
     assert(impl);
+    CONSOLE_TRACE_SCOPE("render_frame");
 
-    // Should not fail unless memory starvation.
-    console::SDL_RenderClear(impl->window.renderer());
+    // Nothing would be seen. Events and tasks are still handled.
+    if (console::SDL_GetWindowFlags(impl->window.handle) & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN)) {
+        impl->counters.frames_skipped++;
+        impl->counters.publish(tally, false);
+        impl->window.widget_context.frame_arena.reset();
+        return 0;
+    }
+
+    impl->latency.frame_started();
+    auto frame_start = Clock::now();
 
     //  set background color
     // Should not fail unless renderer is invalid
+    set_draw_color(impl->window.renderer(), impl->window.log_screen.bg_color);
+
+    // Should not fail unless memory starvation.
+    console::SDL_RenderClear(impl->window.renderer());
     set_draw_color(impl->window.renderer(), colors::darkgray);
 
+    if (impl->window.status_bar.sample(impl->status_slots))
+        impl->window.layout();
+
     impl->window.toolbar->render();
+    impl->window.status_bar.render();
 
     /* render text area */
 
     impl->window.log_screen.render();
+    if (impl->latency.overlay)
+        impl->latency.render_overlay(impl->window.renderer(), *impl->window.font, impl->window.log_screen.viewport);
 
     console::SDL_RenderPresent(impl->window.renderer());
+    impl->latency.presented();
+
+    auto render_time = Clock::now() - frame_start;
+    impl->counters.add_frame_time(render_time);
+    impl->counters.frames_rendered++;
+    impl->counters.scrollback_bytes = impl->window.log_screen.scrollback_bytes;
+    impl->counters.last_line_presented = impl->window.log_screen.newest_id;
+
+    auto& hud = impl->window.log_screen.hud;
+    if (hud.visible) {
+        hud.add_sample({ frame_start,
+            static_cast<Uint32>(std::chrono::duration_cast<std::chrono::microseconds>(render_time).count()),
+            0,
+            static_cast<Uint32>(tally.wrap_ns / 1000),
+            static_cast<Uint32>(impl->external_event_waiter.api.size()),
+            static_cast<Uint32>(tally.draw_calls),
+            impl->counters.lines_ingested,
+            impl->window.log_screen.scrollback_bytes });
+    }
+    impl->counters.publish(tally, true);
+    impl->window.widget_context.frame_arena.reset();
 
     return 0;
 }
 
+/* Add count lines from a command to its batch. Returns the first id. */
+Console_LineId add_command_output(Console_con* con, LogEntry* entries, size_t count)
+{
+    Console_LineId first = 0;
+    auto add = [&](OutputBatch& batch) {
+        first = con->next_line_id.fetch_add(count);
+        for (size_t i = 0; i < count; ++i)
+            batch.lines.emplace_back(first + i, std::move(entries[i]));
+    };
+    auto& api = con->external_event_waiter.api;
+    if (command_output) {
+        bool added = api.append_last(command_output->ticket, [&] {
+            std::scoped_lock lock(command_output->mutex);
+            if (command_output->taken)
+                return false;
+            add(*command_output);
+            return true;
+        });
+        if (added)
+            return first;
+    }
+
+    command_output = std::make_shared<OutputBatch>();
+    auto task = [con, batch = command_output] {
+        std::vector<std::pair<Console_LineId, LogEntry>> lines;
+        {
+            std::scoped_lock lock(batch->mutex);
+            batch->taken = true;
+            lines.swap(batch->lines);
+        }
+        for (auto& [id, entry] : lines) {
+            con->lscreen().add_output_entry(std::move(entry), id);
+        }
+    };
+    // The render thread can't see the batch before it's queued
+    command_output->ticket = api.push(std::move(task), [&] { add(*command_output); });
+    return first;
+}
+
+void run_command(Console_con* con, Console_CommandHandler handler, const char* args)
+{
+    CONSOLE_TRACE_SCOPE("command");
+    command_con = con;
+    handler(con, args);
+    command_con = nullptr;
+    command_output.reset();
+}
+
 int handle_sdl_event(Console_con::Impl* impl, SDL_Event& e)
 {
+    CONSOLE_TRACE_SCOPE("handle_sdl_event");
     impl->internal_emitter.emit(e);
     return 0;
 }
@@ -2472,9 +6035,12 @@ int on_sdl_event(void* data, SDL_Event* e)
         return con->impl->event_filter_setter.maybe_call_saved(data, e);
     }
 
-    SDL_Event ec;
-    std::memcpy(&ec, e, sizeof(SDL_Event));
-    con->external_event_waiter.sdl.push(ec);
+    QueuedEvent ec;
+    std::memcpy(&ec.event, e, sizeof(SDL_Event));
+    ec.received = Clock::now();
+    con->counters.sdl_events_received++;
+    if (con->external_event_waiter.sdl.push_merging(ec, merge_motion))
+        con->counters.sdl_events_coalesced++;
     return 0;
 }
 }
@@ -2572,7 +6138,7 @@ void Console_SetPrompt(Console_con* con,
     const char* prompt)
 {
     auto str = from_utf8(prompt);
-    con->external_event_waiter.api.push([con, str = std::move(str)] {
+    con->push_task([con, str = std::move(str)] {
         con->lscreen().prompt.set_prompt(str);
     });
 }
@@ -2580,6 +6146,7 @@ void Console_SetPrompt(Console_con* con,
 /* XXX: cleanup */
 int Console_MainLoop(Console_con* con)
 {
+    CONSOLE_TRACE_THREAD_NAME("console render");
     while (1) {
         auto impl = con->impl.get();
         // No mutex should be needed yet.
@@ -2587,21 +6154,35 @@ int Console_MainLoop(Console_con* con)
         if (render_frame(impl))
             return -1;
 
-        impl->external_event_waiter.wait_for_events();
         {
+            CONSOLE_TRACE_SCOPE("wait_for_events");
+            impl->external_event_waiter.wait_for_events();
+        }
+        {
+            CONSOLE_TRACE_SCOPE("dispatch");
             std::scoped_lock lock(con->mutex);
-            SDL_Event event;
-            while (impl->external_event_waiter.sdl.pop(event)) {
-                handle_sdl_event(impl, event);
+            auto dispatch_start = Clock::now();
+            QueuedEvent queued;
+            while (impl->external_event_waiter.sdl.pop(queued)) {
+                auto dequeued = Clock::now();
+                handle_sdl_event(impl, queued.event);
+                if (LatencyTracer::traced(queued.event))
+                    impl->latency.dispatched(queued.received, dequeued);
             }
             ExternalEventWaiter::Task f;
             while (impl->external_event_waiter.api.pop(f)) {
+                CONSOLE_TRACE_SCOPE("api_task");
                 f();
             }
+            auto& hud = impl->window.log_screen.hud;
+            if (hud.visible)
+                hud.dispatch_us += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - dispatch_start).count();
         }
+        impl->commands.run_deferred(con);
 
         if (con->is_shuttingdown()) {
             impl->event_filter_setter.reset_saved();
+            impl->commands.shutdown();
             impl->input_line_waiter.shutdown();
             {
                 std::scoped_lock l(con->getline_inproc_mutex);
@@ -2618,24 +6199,106 @@ int Console_MainLoop(Console_con* con)
     return 0;
 }
 
-void Console_AddLine(Console_con* con, const char* s)
+/*
+ * New lines are decoded and their escape sequences parsed here, on the
+ * caller's thread, so the render thread only has to wrap and link them.
+ */
+Console_LineId Console_AddLine(Console_con* con, const char* s)
+{
+    auto entry = make_output_entry(from_utf8(s), con->overwrite_on_cr);
+    con->counters.ingested(s, 1);
+    if (command_con == con)
+        return add_command_output(con, &entry, 1);
+    // Tasks must be copyable, the entry isn't. The id is filled in as the
+    // task is queued.
+    auto line = std::make_shared<std::pair<Console_LineId, LogEntry>>(0, std::move(entry));
+    auto task = [con, line] {
+        con->lscreen().add_output_entry(std::move(line->second), line->first);
+    };
+    return con->push_lines(std::move(task), line->first, 1);
+}
+
+Console_LineId Console_AddLines(Console_con* con, const char* const* lines, int count)
+{
+    if (count <= 0)
+        return 0;
+    auto entries = std::make_shared<std::vector<LogEntry>>();
+    entries->reserve(count);
+    bool overwrite_on_cr = con->overwrite_on_cr;
+    for (int i = 0; i < count; ++i) {
+        entries->push_back(make_output_entry(from_utf8(lines[i]), overwrite_on_cr));
+        con->counters.ingested(lines[i], 1);
+    }
+    if (command_con == con)
+        return add_command_output(con, entries->data(), count);
+    auto first = std::make_shared<Console_LineId>(0);
+    auto task = [con, first, entries] {
+        for (size_t i = 0; i < entries->size(); ++i)
+            con->lscreen().add_output_entry(std::move((*entries)[i]), *first + i);
+    };
+    return con->push_lines(std::move(task), *first, count);
+}
+
+void Console_UpdateLine(Console_con* con, Console_LineId id, const char* s)
 {
     auto str = from_utf8(s);
-    con->external_event_waiter.api.push([con, str = std::move(str)] {
-        con->lscreen().on_new_output_line(str);
+    con->counters.ingested(s, 0);
+    con->push_task([con, id, str = std::move(str)] {
+        con->lscreen().on_update_line(id, str);
     });
 }
 
-void Console_SetBackgroundColor(Console_con* con, const SDL_Color c)
+void Console_AppendToLine(Console_con* con, Console_LineId id, const char* s)
 {
-    std::scoped_lock lock(con->mutex);
-    con->impl->bg_color = c;
+    auto str = from_utf8(s);
+    con->counters.ingested(s, 0);
+    con->push_task([con, id, str = std::move(str)] {
+        con->lscreen().on_append_to_line(id, str);
+    });
 }
 
-void Console_SetFontColor(Console_con* con, const SDL_Color c)
+void Console_RemoveLine(Console_con* con, Console_LineId id)
 {
-    std::scoped_lock lock(con->mutex);
-    con->impl->font_color = c;
+    con->push_task([con, id] {
+        con->lscreen().on_remove_line(id);
+    });
+}
+
+void Console_SetOverwriteOnCR(Console_con* con, bool enable)
+{
+    con->overwrite_on_cr = enable;
+    con->push_task([con, enable] {
+        con->lscreen().overwrite_on_cr = enable;
+    });
+}
+
+void Console_SetLineWrap(Console_con* con, bool enable)
+{
+    con->push_task([con, enable] {
+        con->lscreen().set_line_wrap(enable);
+    });
+}
+
+static SDL_Color to_sdl_color(const Console_Color& c)
+{
+    return { static_cast<Uint8>(std::clamp(c.r, 0, 255)),
+        static_cast<Uint8>(std::clamp(c.g, 0, 255)),
+        static_cast<Uint8>(std::clamp(c.b, 0, 255)),
+        static_cast<Uint8>(std::clamp(c.a, 0, 255)) };
+}
+
+void Console_SetBackgroundColor(Console_con* con, Console_Color c)
+{
+    con->push_task([con, c = to_sdl_color(c)] {
+        con->lscreen().bg_color = c;
+    });
+}
+
+void Console_SetFontColor(Console_con* con, Console_Color c)
+{
+    con->push_task([con, c = to_sdl_color(c)] {
+        con->lscreen().font_color = c;
+    });
 }
 
 int Console_GetColumns(Console_con* con)
@@ -2650,9 +6313,96 @@ int Console_GetRows(Console_con* con)
     return con->lscreen().rows();
 }
 
+void Console_GetStats(Console_con* con, Console_Stats* stats)
+{
+    // Set up when the window is created and not changed after
+    auto& window = con->impl->window;
+    *stats = {};
+    std::snprintf(stats->renderer, sizeof(stats->renderer), "%s", window.backend.c_str());
+    stats->glyph_rate = window.glyph_rate;
+    stats->software_raster = window.log_screen.raster != nullptr;
+
+    auto& c = con->counters;
+    stats->lines_ingested = c.lines_ingested;
+    stats->bytes_ingested = c.bytes_ingested;
+    stats->lines_dropped = c.lines_dropped;
+    stats->api_queue_depth = con->external_event_waiter.api.size();
+    stats->api_queue_high_water = con->external_event_waiter.api.high_water();
+    stats->sdl_events_received = c.sdl_events_received;
+    stats->sdl_events_coalesced = c.sdl_events_coalesced;
+    stats->wraps = c.wraps;
+    stats->wrap_time_us = c.wrap_ns / 1000.0;
+    stats->frames_rendered = c.frames_rendered;
+    stats->frames_skipped = c.frames_skipped;
+    stats->glyphs_last_frame = c.glyphs_last_frame;
+    stats->draw_calls_last_frame = c.draw_calls_last_frame;
+    stats->scrollback_bytes = c.scrollback_bytes;
+    stats->last_line_presented = c.last_line_presented;
+    {
+        std::scoped_lock lock(c.frame_time_mutex);
+        stats->frame_p50_us = c.frame_time.percentile(0.5);
+        stats->frame_p99_us = c.frame_time.percentile(0.99);
+        stats->frame_max_us = c.frame_time.max;
+    }
+}
+
+void Console_GetLatencyStats(Console_con* con, Console_LatencyStats* stats)
+{
+    con->impl->latency.get(*stats);
+}
+
+void Console_ResetLatencyStats(Console_con* con)
+{
+    con->push_task([con] {
+        con->impl->latency.reset();
+    });
+}
+
+void Console_GetMemoryUsage(Console_MemoryUsage usage[CONSOLE_MEMORY_COUNT])
+{
+    for (int i = 0; i < CONSOLE_MEMORY_COUNT; ++i) {
+        auto& a = memory::accounts[i];
+        usage[i].bytes = std::max<Sint64>(a.bytes, 0);
+        usage[i].allocations = std::max<Sint64>(a.allocations, 0);
+        usage[i].total_allocations = a.total_allocations;
+    }
+}
+
+const char* Console_GetMemorySubsystemName(int subsystem)
+{
+    if (subsystem < 0 || subsystem >= CONSOLE_MEMORY_COUNT)
+        return nullptr;
+    return memory::names[subsystem];
+}
+
+bool Console_SetAllocator(const Console_Allocator* allocator)
+{
+    if (allocator && (!allocator->alloc || !allocator->free))
+        return false;
+    return memory::upstream.set_hook(allocator ? *allocator : Console_Allocator {});
+}
+
+void Console_ShowLatencyOverlay(Console_con* con, bool show)
+{
+    con->push_task([con, show] {
+        con->impl->latency.overlay = show;
+    });
+}
+
+bool Console_DumpTrace(Console_con* con, const char* path)
+{
+    (void)con; // the rings are per thread, not per console
+#if CONSOLE_ENABLE_TRACE
+    return trace::dump(path);
+#else
+    (void)path;
+    return false;
+#endif
+}
+
 void Console_Clear(Console_con* con)
 {
-    con->external_event_waiter.api.push([con] {
+    con->push_task([con] {
         con->lscreen().clear();
     });
 }
@@ -2662,7 +6412,7 @@ void Console_Shutdown(Console_con* con)
     assert(con);
     con->status = State::shutdown;
     // Must push an event to wake up the main render thread
-    con->external_event_waiter.api.push([] {});
+    con->push_task([] {});
 }
 
 // XXX: cleanup properly
@@ -2693,25 +6443,62 @@ int Console_GetLine(Console_con* con, std::string& buf)
 
 void Console_SetScrollback(Console_con* con, const int lines)
 {
-    con->external_event_waiter.api.push([con, lines = lines] {
+    con->push_task([con, lines = lines] {
         con->lscreen().max_lines = lines;
     });
 }
 
 void Console_ShowWindow(Console_con* con)
 {
-    con->external_event_waiter.api.push([con] {
+    con->push_task([con] {
         console::SDL_ShowWindow(con->impl->window.handle);
     });
 }
 
 void Console_HideWindow(Console_con* con)
 {
-    con->external_event_waiter.api.push([con] {
+    con->push_task([con] {
         console::SDL_HideWindow(con->impl->window.handle);
     });
 }
 
+bool Console_RegisterCommand(Console_con* con,
+    const char* name,
+    Console_CommandHandler handler,
+    int flags)
+{
+    if (name == nullptr || handler == nullptr)
+        return false;
+
+    std::scoped_lock lock(con->mutex);
+    return con->impl->commands.add(from_utf8(name), handler, flags);
+}
+
+void Console_SetMode(Console_con* con, int mode)
+{
+    con->push_task([con, mode] {
+        con->lscreen().set_screen_mode(mode == CONSOLE_MODE_SCREEN);
+    });
+}
+
+void Console_Write(Console_con* con, const char* s)
+{
+    auto str = from_utf8(s);
+    con->counters.ingested(s, 0);
+    con->push_task([con, str = std::move(str)] {
+        con->lscreen().screen.screen.write(str);
+    });
+}
+
+void Console_SetStatus(Console_con* con, int slot, const char* text)
+{
+    if (slot < 0 || slot >= CONSOLE_STATUS_SLOTS)
+        return;
+
+    con->status_slots.set(slot, new std::u32string(text ? from_utf8(text) : U""));
+    con->external_event_waiter.wake();
+}
+
 const char*
 Console_GetError(void)
 {
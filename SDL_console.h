@@ -7,15 +7,144 @@
 struct Console_con;
 typedef struct Console_con Console_con;
 
+/* Number of slots in the status line. */
+#define CONSOLE_STATUS_SLOTS 4
+
+enum Console_Mode {
+    /* Scrollback of lines added with Console_AddLine(). */
+    CONSOLE_MODE_LOG = 0,
+    /* Fixed grid of cells written with Console_Write(). */
+    CONSOLE_MODE_SCREEN = 1
+};
+
+/* Handle to an output line. 0 is never a valid id. */
+typedef unsigned long long Console_LineId;
+
 typedef struct _console_color {
     int r, g, b, a;
 } Console_Color;
 
+/*
+ * SDL hint read by Console_Create() to choose the renderer. Set it with
+ * SDL_SetHint() or in the environment.
+ *   "auto"         accelerated, or software if that fails (default)
+ *   "accelerated"  accelerated only
+ *   "software"     SDL's software renderer only
+ *   "probe"        time glyph drawing on each and keep the fastest
+ */
+#define CONSOLE_HINT_RENDERER "CONSOLE_RENDERER"
+
+typedef struct _console_stats {
+    /* Name of the SDL render driver in use. */
+    char renderer[32];
+    /* Glyphs per second measured by the "probe" renderer hint, else 0. */
+    double glyph_rate;
+    /* Text is rasterized on the CPU rather than drawn glyph by glyph. */
+    int software_raster;
+
+    /* Lines added through the API, and bytes of text passed in. */
+    unsigned long long lines_ingested, bytes_ingested;
+    /* Lines cycled out of the scrollback. */
+    unsigned long long lines_dropped;
+    /* API calls waiting for the render thread, now and at most. */
+    unsigned long long api_queue_depth, api_queue_high_water;
+    /* SDL events taken, and mouse motions merged into a queued one. */
+    unsigned long long sdl_events_received, sdl_events_coalesced;
+    /* Times text was wrapped into lines, and the total time it took. */
+    unsigned long long wraps;
+    double wrap_time_us;
+    /* Frames drawn, and skipped while the window was hidden or minimized. */
+    unsigned long long frames_rendered, frames_skipped;
+    /* Glyphs and the draw calls for text in the last frame drawn. */
+    unsigned long long glyphs_last_frame, draw_calls_last_frame;
+    /* Microseconds from the start of a frame to its present. */
+    double frame_p50_us, frame_p99_us, frame_max_us;
+    /* Bytes held by the scrollback. */
+    unsigned long long scrollback_bytes;
+    /*
+     * Console_LineId up to which every line added had been added to the
+     * scrollback when the last frame was presented. Lines are added in id
+     * order, also with several producers.
+     */
+    unsigned long long last_line_presented;
+} Console_Stats;
+
+typedef struct _console_latency_stats {
+    /* Number of inputs measured. */
+    unsigned long long count;
+    /*
+     * Microseconds from the console receiving a key press or text input to
+     * the end of the first SDL_RenderPresent() that shows it.
+     */
+    double p50_us, p99_us, max_us;
+    /*
+     * Medians of the stages adding up to it: waiting in the event queue,
+     * running handlers, waiting for the next frame and rendering it.
+     */
+    double queue_p50_us, dispatch_p50_us, frame_wait_p50_us, render_p50_us;
+} Console_LatencyStats;
+
+/* What Console_GetMemoryUsage() accounts heap use to. */
+enum Console_MemorySubsystem {
+    /* Text of the scrollback's lines. */
+    CONSOLE_MEMORY_ENTRY_TEXT,
+    /* The lines' wrapped segments. */
+    CONSOLE_MEMORY_WRAP_LINES,
+    /* Line records and the index of line ids. */
+    CONSOLE_MEMORY_ENTRIES,
+    /* Prompt history. */
+    CONSOLE_MEMORY_HISTORY,
+    /* Calls waiting for the render thread, not counting their arguments. */
+    CONSOLE_MEMORY_API_QUEUE,
+    /* SDL events waiting for the render thread. */
+    CONSOLE_MEMORY_SDL_QUEUE,
+    /* Glyph tables and masks. Textures are not counted. */
+    CONSOLE_MEMORY_FONT,
+    /* Blocks of the frame arena, which holds data that lasts a frame. */
+    CONSOLE_MEMORY_FRAME,
+    /* Widgets' event handler tables. */
+    CONSOLE_MEMORY_EVENT_HANDLERS,
+    CONSOLE_MEMORY_COUNT
+};
+
+typedef struct _console_memory_usage {
+    /* Live bytes and allocations. */
+    unsigned long long bytes, allocations;
+    /* Allocations ever made. */
+    unsigned long long total_allocations;
+} Console_MemoryUsage;
+
+/*
+ * Allocation functions for the console's memory. alloc returns size bytes
+ * aligned to align, or NULL. free gets the size and align it was
+ * allocated with.
+ */
+typedef struct _console_allocator {
+    void* (*alloc)(void* user, size_t size, size_t align);
+    void (*free)(void* user, void* ptr, size_t size, size_t align);
+    void* user;
+} Console_Allocator;
+
 extern "C" {
 
 typedef void* (*Console_SymResolverProc)(const char*);
 void Console_Init(Console_SymResolverProc);
 
+/*
+ * Called with the text following the command name.
+ */
+typedef void (*Console_CommandHandler)(Console_con* con, const char* args);
+
+enum Console_CommandFlags {
+    /* Run the handler on the command worker pool. */
+    CONSOLE_COMMAND_DEFAULT = 0,
+    /*
+     * Run the handler on the render thread, between frames and without the
+     * console locked. Only for short commands.
+     */
+    CONSOLE_COMMAND_RENDER_THREAD = 1 << 0
+};
+
 Console_con*
 Console_Create(const char* title,
     const char* prompt,
@@ -54,13 +183,120 @@ int Console_MainLoop(Console_con* con);
 const char*
 Console_GetError(void);
 
-void Console_AddLine(Console_con* con, const char* s);
+Console_LineId Console_AddLine(Console_con* con, const char* s);
+
+/*
+ * Add count lines at once, cheaper than as many Console_AddLine() calls.
+ * Returns the id of the first; the others follow it in order.
+ */
+Console_LineId Console_AddLines(Console_con* con, const char* const* lines, int count);
+
+/*
+ * Replace the text of a line added by Console_AddLine(). Lines that have
+ * since been removed or cycled out of the scrollback are ignored.
+ */
+void Console_UpdateLine(Console_con* con, Console_LineId id, const char* s);
+
+void Console_AppendToLine(Console_con* con, Console_LineId id, const char* s);
+
+void Console_RemoveLine(Console_con* con, Console_LineId id);
+
+/*
+ * When enabled, a '\r' in output returns to the start of the line and the
+ * text following it overwrites what was there, as on a terminal. Lines
+ * added after this call are affected.
+ */
+void Console_SetOverwriteOnCR(Console_con* con, bool enable);
+
+/*
+ * Wrapping of the scrollback is on by default. When off, lines only break at
+ * newlines and are scrolled horizontally with the mouse wheel's horizontal
+ * axis, Shift+wheel or the scrollbar under the log.
+ */
+void Console_SetLineWrap(Console_con* con, bool enable);
 
 int Console_GetLine(Console_con* con, std::string& buf);
 
 bool Console_HasFocus(Console_con* con);
 
+/*
+ * Runtime counters. Safe to call from any thread; the counters are read
+ * one at a time, so they may be from slightly different moments.
+ */
+void Console_GetStats(Console_con* con, Console_Stats* stats);
+
+/*
+ * Input latency, see Console_LatencyStats. Percentiles are accurate to
+ * about 20%.
+ */
+void Console_GetLatencyStats(Console_con* con, Console_LatencyStats* stats);
+
+void Console_ResetLatencyStats(Console_con* con);
+
+/*
+ * Heap use of all consoles in the process, indexed by
+ * Console_MemorySubsystem. Safe to call from any thread.
+ */
+void Console_GetMemoryUsage(Console_MemoryUsage usage[CONSOLE_MEMORY_COUNT]);
+
+const char* Console_GetMemorySubsystemName(int subsystem);
+
+/*
+ * Allocate the memory counted by Console_GetMemoryUsage() with allocator,
+ * or with operator new again if NULL. Only possible until the first of it
+ * is allocated, so call it before Console_Create(); returns false after.
+ * Captured arguments of queued calls and std::function targets still use
+ * the global heap. The allocator must be thread-safe: both functions are
+ * called from whichever threads call Console_AddLine() and
+ * Console_AddLines(), which build the lines, as well as from the console's
+ * own threads, which render, rewrap and free scrollback.
+ */
+bool Console_SetAllocator(const Console_Allocator* allocator);
+
+/*
+ * Show the latency percentiles at the top right of the console.
+ */
+void Console_ShowLatencyOverlay(Console_con* con, bool show);
+
+/*
+ * Write the most recent trace events of each thread to path as Chrome
+ * trace_event JSON, for chrome://tracing or Perfetto. Timestamps are
+ * std::chrono::steady_clock microseconds. Returns false if the file can't
+ * be written, or if built without CONSOLE_ENABLE_TRACE.
+ */
+bool Console_DumpTrace(Console_con* con, const char* path);
+
+/*
+ * Switch between the scrollback and the screen grid, which fills the area
+ * above the prompt. Lines added in screen mode still go to the scrollback.
+ */
+void Console_SetMode(Console_con* con, int mode);
+
+/*
+ * Write to the screen grid. Understands a subset of VT100 control
+ * sequences: cursor movement, erase in display/line and SGR attributes.
+ */
+void Console_Write(Console_con* con, const char* s);
+
+/*
+ * Set the text of a status slot. Slots are laid out side by side in a line
+ * below the toolbar, shown while any slot has text. Cheap enough to call
+ * every frame from any thread: the render thread only picks up the latest
+ * text of each slot once per frame. NULL or "" clears the slot.
+ */
+void Console_SetStatus(Console_con* con, int slot, const char* text);
+
 void Console_SetScrollback(Console_con* con, const int lines);
+
+/*
+ * Register a command. Input lines starting with a registered name are
+ * dispatched to its handler instead of being returned by Console_GetLine().
+ * Returns false if the name is empty, contains whitespace or is taken.
+ */
+bool Console_RegisterCommand(Console_con* con,
+    const char* name,
+    Console_CommandHandler handler,
+    int flags);
 }
 
 #endif
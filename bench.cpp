@@ -0,0 +1,549 @@
+/*
+ * Microbenchmarks for the text pipeline. SDL_console.cpp is included to get
+ * at its internals. Results are printed as JSON: nanoseconds per op, bytes
+ * of input per second and heap allocations per op. Then the heap held by
+ * scrollbacks of 1k to 1M log lines, per Console_MemorySubsystem.
+ *
+ * Drawing a frame and typing at the prompt must not allocate once warmed
+ * up, and wrap_entry() must give the same lines as the per-character loop
+ * it replaced; if not, the bench exits with status 1.
+ *
+ *   make bench && ./bench [name filter]
+ *
+ * Inputs are fixed, so runs are comparable between builds.
+ */
+#include "SDL_console.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <time.h>
+
+static std::atomic<size_t> allocations { 0 };
+
+// Replacements count allocations. GCC sees std::free() in them freeing
+// what an inlined operator new returned, and takes that for a mismatch.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t n)
+{
+    allocations++;
+    if (void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t n, std::align_val_t align)
+{
+    allocations++;
+    if (void* p = std::aligned_alloc(static_cast<size_t>(align), (n + static_cast<size_t>(align) - 1) & ~(static_cast<size_t>(align) - 1)))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+const char* filter = nullptr;
+const char* separator = "";
+constexpr double min_seconds = 0.25;
+
+/* Keep the compiler from optimizing away a result. */
+template <typename T>
+void keep(T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+void report(const std::string& name, size_t iterations, double seconds, size_t bytes, size_t allocs)
+{
+    std::printf("%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, \"bytes_per_sec\": %.0f, \"allocs_per_op\": %.3f}",
+        separator, name.c_str(), iterations, seconds * 1e9 / iterations,
+        bytes ? bytes * iterations / seconds : 0.0, static_cast<double>(allocs) / iterations);
+    separator = ",";
+}
+
+/*
+ * Run op in growing batches until a batch takes min_seconds, then report
+ * that batch. bytes is the input size of one op, 0 if it has none.
+ * Returns the allocations per op.
+ */
+template <typename F>
+double run(const std::string& name, size_t bytes, F&& op)
+{
+    if (filter && name.find(filter) == std::string::npos)
+        return 0;
+
+    op(); // warm up
+    size_t iterations = 1;
+    double seconds = 0;
+    size_t allocs = 0;
+    while (1) {
+        size_t allocs_before = allocations;
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            op();
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        allocs = allocations - allocs_before;
+        if (seconds >= min_seconds || iterations >= (size_t(1) << 32))
+            break;
+        double grow = seconds > 0 ? min_seconds / seconds * 1.2 : 100;
+        iterations = static_cast<size_t>(iterations * std::clamp(grow, 2.0, 100.0));
+    }
+
+    report(name, iterations, seconds, bytes, allocs);
+    return static_cast<double>(allocs) / iterations;
+}
+
+std::string repeat(const std::string& s, size_t bytes)
+{
+    std::string out;
+    while (out.size() < bytes)
+        out += s;
+    return out;
+}
+
+const char* lorem = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed tincidunt, odio quis "
+                    "pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo. ";
+
+struct Input {
+    const char* name;
+    std::string text;
+};
+
+std::vector<Input> inputs()
+{
+    return {
+        { "short", "hello world, this is a short line" },
+        { "long", repeat(lorem, 4096) },
+        { "no_whitespace", std::string(4096, 'f') },
+        { "newlines", repeat("ab\n", 4096) },
+        { "utf8", repeat("\xe2\x9d\xa4 \xe2\x99\xa5 Really long output! ", 4096) },
+    };
+}
+
+/* Log lines like a service's: timestamps, levels, some colour, a few long ones. */
+std::string log_line(std::mt19937& rng, int i)
+{
+    static const char* levels[] = { "DEBUG", "INFO ", "INFO ", "INFO ", "WARN ", "\x1b[31mERROR\x1b[0m" };
+    static const char* paths[] = { "/api/v1/items", "/api/v1/users", "/healthz", "/static/app.js" };
+    auto pick = [&](unsigned n) { return static_cast<unsigned>(rng() % n); };
+    char buf[256];
+    int n = std::snprintf(buf, sizeof(buf), "2026-10-17 12:%02d:%02d.%03d %s [worker-%u] GET %s/%u -> %d in %ums",
+        i / 60000 % 60, i / 1000 % 60, i % 1000, levels[pick(6)], pick(16), paths[pick(4)],
+        pick(100000), pick(10) ? 200 : 500, pick(250));
+    std::string line(buf, n);
+    if (pick(20) == 0)
+        line += std::string(" ") + lorem + lorem;
+    return line;
+}
+
+std::vector<std::u32string> log_lines(int n)
+{
+    std::mt19937 rng(1);
+    std::vector<std::u32string> lines;
+    for (int i = 0; i < n; ++i)
+        lines.push_back(from_utf8(log_line(rng, i).c_str()));
+    return lines;
+}
+
+/* A widget tree like the console's, drawing into a surface. */
+struct Harness {
+    Harness()
+    {
+        surface = SDL_CreateRGBSurfaceWithFormat(0, 1280, 720, 32, SDL_PIXELFORMAT_ARGB8888);
+        renderer = SDL_CreateSoftwareRenderer(surface);
+        if (!renderer) {
+            std::fprintf(stderr, "SDL_CreateSoftwareRenderer: %s\n", ::SDL_GetError());
+            std::exit(1);
+        }
+        loader = std::make_unique<BMPFontLoader>(renderer);
+        glyphs = loader->build_glyph_rects(128, 192, 16, 16);
+        font = std::make_unique<Font>(*loader, nullptr, glyphs, 8, 12);
+        context = std::make_unique<WidgetContext>(renderer, &emitter, mouse);
+        root = std::make_unique<Widget>(font.get(), *context, SDL_Rect { 0, 0, 1280, 720 });
+    }
+
+    ~Harness()
+    {
+        root.reset();
+        ::SDL_DestroyRenderer(renderer);
+        ::SDL_FreeSurface(surface);
+    }
+
+    SDL_Surface* surface;
+    SDL_Renderer* renderer;
+    EventEmitter emitter;
+    SDL_Point mouse {};
+    std::unique_ptr<BMPFontLoader> loader;
+    std::vector<Glyph> glyphs;
+    std::unique_ptr<Font> font;
+    std::unique_ptr<WidgetContext> context;
+    std::unique_ptr<Widget> root;
+};
+
+using Segments = std::vector<std::pair<size_t, size_t>>;
+
+/*
+ * Lines as the wrap before the break index made them, one character at a
+ * time: a full line is cut after its last space or tab, or else after the
+ * character that fills it. Each is [start, end), the last end being npos.
+ */
+Segments reference_wrap(const std::u32string& text, int width, int advance)
+{
+    Segments out;
+    size_t delim = 0, start = 0, end = 0;
+    auto add = [&](size_t s, size_t e) {
+        if (e > s)
+            out.push_back({ s, e });
+    };
+    for (auto ch : text) {
+        if (ch == U'\n' || ch == U'\r') {
+            add(start, end);
+            start = end + 1;
+            delim = 0;
+        } else if (ch == U' ' || ch == U'\t') {
+            delim = end;
+        } else if (static_cast<long long>(end - start + 1) * advance >= width) {
+            if (delim) {
+                add(start, delim + 1);
+                start = delim + 1;
+            } else {
+                add(start, end + 1);
+                start = end + 1;
+            }
+            delim = 0;
+        }
+        end++;
+    }
+    if (end > start)
+        add(start, std::u32string::npos);
+    return out;
+}
+
+/* Lines of entry after wrap_entry(), as reference_wrap() gives them. */
+bool wraps_as_reference(LogEntry& entry, const std::u32string& text, int width, int advance)
+{
+    wrap_entry(entry, width, advance);
+    auto ref = reference_wrap(text, width, advance);
+    if (entry.size != ref.size())
+        return false;
+    for (size_t i = 0; i < ref.size(); ++i) {
+        auto& line = entry.line(i);
+        size_t end = std::min(ref[i].second, text.length());
+        if (line.start_index != ref[i].first || line.end_index != ref[i].second
+            || line.text != std::u32string_view(text).substr(ref[i].first, end - ref[i].first))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Compare wrap_entry() with reference_wrap() on random texts: short ones
+ * heavy in breaks at odd widths and advances, including no wrapping at all,
+ * and a few long enough to be wrapped in chunks. Returns the mismatches.
+ */
+int check_wrap()
+{
+    std::mt19937 rng(5);
+    const char32_t alphabet[] = U"aaaaaaab  \t\n\r";
+    int bad = 0;
+    for (int t = 0; t < 50000; ++t) {
+        std::u32string text;
+        for (int i = rng() % 80; i > 0; --i)
+            text += alphabet[rng() % 13];
+        LogEntry entry(EntryType::output, text);
+        for (int k = 0; k < 3; ++k) {
+            int advance = rng() % 50 == 0 ? 0 : rng() % 3 == 0 ? 1 : 8;
+            int width = rng() % 2 ? static_cast<int>(rng() % 200) - 10 : rng() % 8 == 0 ? INT_MAX : rng() % 2 ? 80 : 41;
+            if (!wraps_as_reference(entry, text, width, advance) && bad++ < 5)
+                std::fprintf(stderr, "wrap mismatch: %zu chars, width %d, advance %d\n", text.length(), width, advance);
+        }
+    }
+    for (int t = 0; t < 6; ++t) {
+        // All one word, then words, then lines
+        std::u32string text;
+        for (int i = 65537 + rng() % 100000; i > 0; --i)
+            text += t % 3 == 0 ? U'x' : alphabet[rng() % (t % 3 == 1 ? 10 : 12)];
+        LogEntry entry(EntryType::output, text);
+        for (int columns : { 80, 17, 80 }) {
+            if (!wraps_as_reference(entry, text, columns * 8, 8) && bad++ < 5)
+                std::fprintf(stderr, "wrap mismatch: %zu chars chunked, %d columns\n", text.length(), columns);
+        }
+    }
+    return bad;
+}
+
+/* Heap held by a scrollback filled with log lines, from the memory accounts. */
+void memory_run(Harness& h, int lines)
+{
+    std::string name = "scrollback_memory/" + std::to_string(lines);
+    if (filter && name.find(filter) == std::string::npos)
+        return;
+
+    Console_MemoryUsage before[CONSOLE_MEMORY_COUNT], after[CONSOLE_MEMORY_COUNT];
+    Console_GetMemoryUsage(before);
+    size_t entries, rows;
+    {
+        LogScreen screen(h.root.get());
+        screen.max_lines = lines;
+        std::mt19937 rng(1);
+        for (int i = 0; i < lines; ++i)
+            screen.on_new_output_line(from_utf8(log_line(rng, i).c_str()));
+        screen.reclaimer.flush();
+        Console_GetMemoryUsage(after);
+        entries = screen.entries.size();
+        rows = screen.num_lines;
+    }
+
+    long long total = 0;
+    std::string subsystems;
+    for (int i = 0; i < CONSOLE_MEMORY_COUNT; ++i) {
+        long long bytes = static_cast<long long>(after[i].bytes) - static_cast<long long>(before[i].bytes);
+        total += bytes;
+        subsystems += (i ? ", \"" : "\"") + std::string(Console_GetMemorySubsystemName(i)) + "\": " + std::to_string(bytes);
+    }
+    std::printf("%s\n    {\"name\": \"%s\", \"entries\": %zu, \"rows\": %zu, \"bytes\": %lld, \"bytes_per_entry\": %.1f, \"subsystems\": {%s}}",
+        separator, name.c_str(), entries, rows, total, entries ? static_cast<double>(total) / entries : 0.0,
+        subsystems.c_str());
+    separator = ",";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    filter = argc > 1 ? argv[1] : nullptr;
+    Harness h;
+    auto all = inputs();
+    int status = 0;
+    if (!filter || std::string("wrap_entry").find(filter) != std::string::npos) {
+        if (int bad = check_wrap()) {
+            std::fprintf(stderr, "wrap_entry differs from the reference in %d cases\n", bad);
+            status = 1;
+        }
+    }
+
+    std::printf("{\"benchmarks\": [");
+
+    for (auto& in : all) {
+        const char* s = in.text.c_str();
+        run(std::string("utf8_strlen/") + in.name, in.text.size(), [&] {
+            size_t n = utf8_strlen(s);
+            keep(n);
+        });
+        run(std::string("from_utf8/") + in.name, in.text.size(), [&] {
+            auto u = from_utf8(s);
+            keep(u);
+        });
+        auto u32 = from_utf8(s);
+        run(std::string("to_utf8/") + in.name, in.text.size(), [&] {
+            auto u = to_utf8(u32);
+            keep(u);
+        });
+    }
+
+    for (int columns : { 40, 80, 200 }) {
+        Widget widget(h.root.get());
+        widget.viewport.w = columns * h.font->char_width;
+        for (auto& in : all) {
+            auto text = from_utf8(in.text.c_str());
+            LogEntry entry(EntryType::output, U"");
+            run(std::string("make_logentry_lines/") + in.name + "/" + std::to_string(columns), in.text.size(), [&] {
+                make_logentry_lines(widget, entry, text);
+                keep(entry);
+            });
+        }
+    }
+
+    {
+        // Full scrollback, so every line added evicts one
+        LogScreen screen(h.root.get());
+        screen.max_lines = 1000;
+        auto line = from_utf8(lorem);
+        for (int i = 0; i < 2000; ++i)
+            screen.on_new_output_line(line);
+        run("create_entry/evict", 0, [&] {
+            screen.on_new_output_line(line);
+        });
+    }
+
+    {
+        // The part of adding a line that the caller's thread does
+        auto lines = log_lines(1000);
+        size_t i = 0;
+        run("ingest/make_output_entry", 0, [&] {
+            auto entry = make_output_entry(lines[i++ % lines.size()], false);
+            keep(entry);
+        });
+    }
+
+    {
+        // Alternate between two widths, as dragging a window edge would
+        LogScreen screen(h.root.get());
+        screen.max_lines = 100000;
+        for (auto& line : log_lines(100000))
+            screen.on_new_output_line(line);
+        // Two widths are served from the entries' cached layouts, a third
+        // in turn has to be wrapped
+        int w = screen.viewport.w;
+        run("rewrap/100000/cached", 0, [&] {
+            screen.viewport.w = screen.viewport.w == w ? w / 2 : w;
+            screen.rewrap();
+        });
+        int step = 0;
+        run("rewrap/100000/new_width", 0, [&] {
+            screen.viewport.w = w - (step++ % 3) * 8 * h.font->char_width;
+            screen.rewrap();
+        });
+    }
+
+    {
+        // A 4 MB line, such as a JSON dump, among ordinary ones
+        LogScreen screen(h.root.get());
+        screen.max_lines = 1 << 20;
+        for (auto& line : log_lines(1000))
+            screen.on_new_output_line(line);
+        screen.on_new_output_line(from_utf8(repeat(lorem, 4 << 20).c_str()));
+        for (auto& line : log_lines(100))
+            screen.on_new_output_line(line);
+        int w = screen.viewport.w;
+        int step = 0;
+        run("giant/rewrap", 0, [&] {
+            screen.viewport.w = w - (step++ % 3) * 8 * h.font->char_width;
+            screen.rewrap();
+        });
+        screen.viewport.w = w;
+        screen.rewrap();
+        run("giant/frame_scrolled", 0, [&] {
+            screen.set_scroll_value(step++ * 7919 % screen.num_lines);
+            screen.render();
+            screen.frame_arena().reset();
+        });
+    }
+
+    {
+        // Without wrapping, a resize only moves the view and a frame draws
+        // only the columns scrolled into it
+        LogScreen screen(h.root.get());
+        screen.max_lines = 100000;
+        for (auto& line : log_lines(100000))
+            screen.on_new_output_line(line);
+        screen.set_line_wrap(false);
+        int w = h.root->viewport.w;
+        int step = 0;
+        run("nowrap/100000/resize", 0, [&] {
+            h.root->viewport.w = w - (step++ % 3) * 8 * h.font->char_width;
+            screen.on_resize();
+        });
+        h.root->viewport.w = w;
+        screen.on_resize();
+        screen.render();
+        run("nowrap/frame_hscrolled", 0, [&] {
+            screen.on_hscroll(step++ % 2 ? 40 : -40);
+            screen.render();
+            screen.frame_arena().reset();
+        });
+    }
+
+    for (int lines : { 1000, 100000 }) {
+        // Clearing happens on the render thread; time one clear of a full
+        // scrollback there, which should not grow with its size. CPU time,
+        // as the freeing may preempt this thread on a single core
+        std::string name = "clear/" + std::to_string(lines);
+        if (filter && name.find(filter) == std::string::npos)
+            continue;
+        LogScreen screen(h.root.get());
+        screen.max_lines = lines;
+        for (auto& line : log_lines(lines))
+            screen.on_new_output_line(line);
+        size_t allocs_before = allocations;
+        timespec start, end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        screen.clear();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+        report(name, 1, seconds, 0, allocations - allocs_before);
+    }
+
+    {
+        // Steady state: a full screen, then a selection, then typing
+        LogScreen screen(h.root.get());
+        for (auto& line : log_lines(2000))
+            screen.on_new_output_line(line);
+        auto frame = [&] {
+            screen.render();
+            screen.frame_arena().reset();
+        };
+        double allocs = run("frame/log_screen", 0, frame);
+        screen.mouse_motion_start = { 20, 40 };
+        screen.mouse_motion_end = { 600, 400 };
+        allocs += run("frame/selection", 0, frame);
+        screen.mouse_motion_start = screen.mouse_motion_end = { -1, -1 };
+        screen.prompt.set_prompt(U"prompt> ");
+        screen.prompt.add_input(U"echo a command being typed");
+        allocs += run("input/keystroke", 0, [&] {
+            screen.prompt.add_input(U"x");
+            frame();
+            screen.prompt.erase_input();
+            frame();
+        });
+        if (allocs > 0) {
+            std::fprintf(stderr, "drawing or typing allocated\n");
+            status = 1;
+        }
+    }
+
+    {
+        EventEmitter emitter;
+        int calls = 0;
+        for (int i = 0; i < 8; ++i) {
+            emitter.connect(SDL_KEYDOWN, [&](SDL_Event&) { calls++; });
+            emitter.connect(SDL_MOUSEMOTION, [&](SDL_Event&) { calls++; });
+        }
+        SDL_Event e {};
+        e.type = SDL_KEYDOWN;
+        run("EventEmitter::emit/8_handlers", 0, [&] {
+            emitter.emit(e);
+        });
+        e.type = SDL_TEXTEDITING;
+        run("EventEmitter::emit/unhandled", 0, [&] {
+            emitter.emit(e);
+        });
+        keep(calls);
+    }
+
+    std::printf("\n],\n\"scrollback_memory\": [");
+    separator = "";
+    for (int lines : { 1000, 10000, 100000, 1000000 })
+        memory_run(h, lines);
+    std::printf("\n]}\n");
+    return status;
+}
@@ -10,6 +10,107 @@ void draw_fun();
 std::atomic<Console_con*> con { nullptr };
 static std::atomic<bool> do_draw { true };
 
+static const char* lorem = "❤ ♥ Really long output! Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed tincidunt, odio quis pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo. Donec id sem sapien. Quisque dignissim eget sem ac bibendum. Suspendisse aliquam est finibus tellus molestie faucibus. Vestibulum volutpat feugiat nulla ut pharetra. Etiam facilisis, nunc in ullamcorper tempus, velit ante molestie turpis, at aliquet orci odio in arcu. Aenean dignissim dolor libero, et rhoncus felis elementum hendrerit. Donec aliquam accumsan nunc, vitae tempor sem tristique non. Duis at velit libero. Fusce ac justo vel leo lacinia vehicula sed vel felis. Nullam lacus orci, faucibus eu dapibus nec, gravida quis dui. Fusce faucibus, eros eu dignissim pharetra, velit velit imperdiet urna, gravida commodo est arcu eget lectus. Nunc leo ipsum, maximus vel dictum sit amet, maximus vitae arcu. Donec suscipit elit nec dolor lobortis rhoncus ♥ ❤";
+
+void cmd_clear(Console_con* con, const char*)
+{
+    Console_Clear(con);
+}
+
+void cmd_test(Console_con* con, const char*)
+{
+    Console_AddLine(con, "❤ ♥ Really long output! Lorem ipsum dolor sit amet, \n \r \nconsectetur adipiscing elit. Sed tincidunt, odio quis pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo. Donec id sem sapien. Quisque dignissim eget sem ac bibendum. Suspendisse aliquam est finibus tellus molestie faucibus. Vestibulum");
+}
+
+void cmd_test2(Console_con* con, const char*)
+{
+    Console_AddLine(con, lorem);
+}
+
+void cmd_test3(Console_con* con, const char*)
+{
+    Console_AddLine(con, "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+}
+
+void cmd_test4(Console_con* con, const char*)
+{
+    Console_AddLine(con, "                                                                                                                                                          ");
+}
+
+void cmd_test5(Console_con* con, const char*)
+{
+    Console_AddLine(con, "\n");
+    Console_AddLine(con, "");
+}
+
+void cmd_test6(Console_con* con, const char*)
+{
+    for (int i = 0; i < 2000; i++) {
+        Console_AddLine(con, lorem);
+    }
+}
+
+void cmd_progress(Console_con* con, const char*)
+{
+    Console_LineId id = Console_AddLine(con, "progress: 0%");
+    for (int i = 1; i <= 100; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::string s = "progress: " + std::to_string(i) + "%";
+        Console_UpdateLine(con, id, s.c_str());
+    }
+}
+
+void cmd_stats(Console_con* con, const char*)
+{
+    Console_Stats stats;
+    Console_GetStats(con, &stats);
+    char buf[256];
+    snprintf(buf, sizeof(buf), "renderer: %s%s, %.0f glyphs/s", stats.renderer,
+        stats.software_raster ? " (cpu raster)" : "", stats.glyph_rate);
+    Console_AddLine(con, buf);
+    snprintf(buf, sizeof(buf), "ingested %llu lines, %llu bytes; dropped %llu; api queue %llu (max %llu); scrollback %llu KiB",
+        stats.lines_ingested, stats.bytes_ingested, stats.lines_dropped, stats.api_queue_depth,
+        stats.api_queue_high_water, stats.scrollback_bytes / 1024);
+    Console_AddLine(con, buf);
+    snprintf(buf, sizeof(buf), "sdl events %llu (%llu coalesced); %llu wraps in %.1fms",
+        stats.sdl_events_received, stats.sdl_events_coalesced, stats.wraps, stats.wrap_time_us / 1000);
+    Console_AddLine(con, buf);
+    snprintf(buf, sizeof(buf), "frames %llu (%llu skipped), p50 %.2fms p99 %.2fms max %.2fms; last frame %llu glyphs, %llu draw calls",
+        stats.frames_rendered, stats.frames_skipped, stats.frame_p50_us / 1000, stats.frame_p99_us / 1000,
+        stats.frame_max_us / 1000, stats.glyphs_last_frame, stats.draw_calls_last_frame);
+    Console_AddLine(con, buf);
+}
+
+void cmd_latency(Console_con* con, const char* args)
+{
+    std::string arg = args;
+    if (arg == "on" || arg == "off") {
+        Console_ShowLatencyOverlay(con, arg == "on");
+        return;
+    }
+    Console_LatencyStats l;
+    Console_GetLatencyStats(con, &l);
+    char buf[256];
+    snprintf(buf, sizeof(buf), "input latency: p50 %.1fms p99 %.1fms max %.1fms over %llu inputs"
+                               " (queue %.1fms, dispatch %.1fms, frame wait %.1fms, render %.1fms)",
+        l.p50_us / 1000, l.p99_us / 1000, l.max_us / 1000, l.count,
+        l.queue_p50_us / 1000, l.dispatch_p50_us / 1000, l.frame_wait_p50_us / 1000, l.render_p50_us / 1000);
+    Console_AddLine(con, buf);
+}
+
+void cmd_trace(Console_con* con, const char* args)
+{
+    const char* path = *args ? args : "console_trace.json";
+    std::string msg = Console_DumpTrace(con, path) ? std::string("trace written to ") + path
+                                                  : std::string("no trace written, is CONSOLE_ENABLE_TRACE set?");
+    Console_AddLine(con, msg.c_str());
+}
+
+void cmd_shutdown(Console_con* con, const char*)
+{
+    Console_Shutdown(con);
+}
+
 int main(int argc, char** argv)
 {
     std::thread th(thread_fun);
@@ -24,39 +125,23 @@ int main(int argc, char** argv)
     printf("\nConsole is ready.\n");
     printf("Window supports %d columns and %d rows of text.\n", Console_GetColumns(con), Console_GetRows(con));
 
-    while (1) {
-        std::string buf;
-        if (Console_GetLine(con, buf) >= 0) {
-            if (buf == "clear") {
-                Console_Clear(con);
-            } else if (buf == "test") {
-                Console_AddLine(con, "❤ ♥ Really long output! Lorem ipsum dolor sit amet, \n \r \nconsectetur adipiscing elit. Sed tincidunt, odio quis pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo. Donec id sem sapien. Quisque dignissim eget sem ac bibendum. Suspendisse aliquam est finibus tellus molestie faucibus. Vestibulum");
-            } else if (buf == "test2") {
-                Console_AddLine(con, "❤ ♥ Really long output! Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed tincidunt, odio quis pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo. Donec id sem sapien. Quisque dignissim eget sem ac bibendum. Suspendisse aliquam est finibus tellus molestie faucibus. Vestibulum volutpat feugiat nulla ut pharetra. Etiam facilisis, nunc in ullamcorper tempus, velit ante molestie turpis, at aliquet orci odio in arcu. Aenean dignissim dolor libero, et rhoncus felis elementum hendrerit. Donec aliquam accumsan nunc, vitae tempor sem tristique non. Duis at velit libero. Fusce ac justo vel leo lacinia vehicula sed vel felis. Nullam lacus orci, faucibus eu dapibus nec, gravida quis dui. Fusce faucibus, eros eu dignissim pharetra, velit velit imperdiet urna, gravida commodo est arcu eget lectus. Nunc leo ipsum, maximus vel dictum sit amet, maximus vitae arcu. Donec suscipit elit nec dolor lobortis rhoncus ♥ ❤");
-
-            } else if (buf == "test3") {
-                Console_AddLine(con, "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
-            } else if (buf == "test4") {
-                Console_AddLine(con, "                                                                                                                                                          ");
-            } else if (buf == "test5") {
-                Console_AddLine(con, "\n");
-                Console_AddLine(con, "");
-            } else if (buf == "test6") {
-                for (int i = 0; i < 2000; i++) {
-                    Console_AddLine(con, "❤ ♥ Really long output! Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed tincidunt, odio quis pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo. Donec id sem sapien. Quisque dignissim eget sem ac bibendum. Suspendisse aliquam est finibus tellus molestie faucibus. Vestibulum volutpat feugiat nulla ut pharetra. Etiam facilisis, nunc in ullamcorper tempus, velit ante molestie turpis, at aliquet orci odio in arcu. Aenean dignissim dolor libero, et rhoncus felis elementum hendrerit. Donec aliquam accumsan nunc, vitae tempor sem tristique non. Duis at velit libero. Fusce ac justo vel leo lacinia vehicula sed vel felis. Nullam lacus orci, faucibus eu dapibus nec, gravida quis dui. Fusce faucibus, eros eu dignissim pharetra, velit velit imperdiet urna, gravida commodo est arcu eget lectus. Nunc leo ipsum, maximus vel dictum sit amet, maximus vitae arcu. Donec suscipit elit nec dolor lobortis rhoncus ♥ ❤");
-                }
-            } else if (buf == "shutdown") {
-                Console_Shutdown(con);
-                break;
-            } else {
-                // echo
-                Console_AddLine(con, buf.c_str());
-            }
-        } else {
-            // GetLine returned < 0
-            Console_Shutdown(con);
-            break;
-        }
+    Console_RegisterCommand(con, "clear", cmd_clear, CONSOLE_COMMAND_RENDER_THREAD);
+    Console_RegisterCommand(con, "test", cmd_test, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "test2", cmd_test2, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "test3", cmd_test3, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "test4", cmd_test4, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "test5", cmd_test5, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "test6", cmd_test6, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "progress", cmd_progress, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "stats", cmd_stats, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "latency", cmd_latency, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "trace", cmd_trace, CONSOLE_COMMAND_DEFAULT);
+    Console_RegisterCommand(con, "shutdown", cmd_shutdown, CONSOLE_COMMAND_RENDER_THREAD);
+
+    // Lines that aren't registered commands are echoed.
+    std::string buf;
+    while (Console_GetLine(con, buf) >= 0) {
+        Console_AddLine(con, buf.c_str());
     }
     do_draw = false;
     th.join();
@@ -0,0 +1,92 @@
+/*
+ * Runs a console with no display, for render_bench.cpp and stress.cpp: SDL's
+ * dummy video driver, the software renderer and a synthetic font.
+ */
+#pragma once
+
+#include "SDL_console.h"
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+/*
+ * Console_Create() loads its font from "test.png" in the working directory.
+ * Write a synthetic 16x16 sheet of 8x12 glyphs there; IMG_Load detects BMP by
+ * content. Magenta is the transparent color.
+ */
+inline bool headless_write_font(const char* path)
+{
+    SDL_Surface* s = SDL_CreateRGBSurfaceWithFormat(0, 128, 192, 8, SDL_PIXELFORMAT_INDEX8);
+    if (!s)
+        return false;
+    SDL_Color colors[2] = { { 255, 0, 255, 255 }, { 255, 255, 255, 255 } };
+    SDL_SetPaletteColors(s->format->palette, colors, 0, 2);
+    Uint8* pixels = static_cast<Uint8*>(s->pixels);
+    for (int y = 0; y < 192; ++y) {
+        for (int x = 0; x < 128; ++x) {
+            int glyph = (y / 12) * 16 + x / 8;
+            bool on = glyph > 32 && ((glyph * 31 + (y % 12) * 7 + (x % 8) * 13) % 3 == 0);
+            pixels[y * s->pitch + x] = on;
+        }
+    }
+    int rc = SDL_SaveBMP(s, path);
+    SDL_FreeSurface(s);
+    return rc == 0;
+}
+
+/*
+ * Starts SDL and a console with its main loop on a thread of its own. Any
+ * Console_Init() must come first. Exits the process if that fails.
+ */
+struct HeadlessConsole {
+    explicit HeadlessConsole(const char* title)
+    {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+        SDL_SetHint(CONSOLE_HINT_RENDERER, "software");
+        if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+            std::fprintf(stderr, "SDL_Init: %s\n", SDL_GetError());
+            std::exit(1);
+        }
+
+        // Keep the font out of the caller's directory
+        char dir[] = "/tmp/console_headless.XXXXXX";
+        char cwd[4096];
+        if (!mkdtemp(dir) || !getcwd(cwd, sizeof(cwd)) || chdir(dir) != 0 || !headless_write_font("test.png")) {
+            std::fprintf(stderr, "failed to write font to %s\n", dir);
+            std::exit(1);
+        }
+
+        std::atomic<Console_con*> created { nullptr };
+        render = std::thread([title, &created] {
+            Console_con* c = Console_Create(title, "> ", 14);
+            if (!c) {
+                std::fprintf(stderr, "Console_Create: %s\n", SDL_GetError());
+                std::exit(1);
+            }
+            created = c;
+            Console_MainLoop(c);
+            Console_Destroy(c);
+        });
+        while (!created)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        con = created;
+
+        unlink("test.png");
+        if (chdir(cwd) == 0)
+            rmdir(dir);
+    }
+
+    ~HeadlessConsole()
+    {
+        Console_Shutdown(con);
+        render.join();
+        SDL_Quit();
+    }
+
+    Console_con* con = nullptr;
+    std::thread render;
+};
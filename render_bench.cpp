@@ -0,0 +1,409 @@
+/*
+ * Headless render benchmark. Console_Init() is handed a resolver that wraps
+ * the SDL draw calls with counters, then scripted scenarios are replayed
+ * against a headless console (headless.h). Per scenario it reports frames,
+ * draw calls and renderer state changes per frame, and render thread CPU
+ * time per frame, as JSON.
+ *
+ *   make render-bench && ./render_bench > baseline.json
+ *   ./render_bench --baseline baseline.json [--threshold 10]
+ *
+ * With --baseline, exits 1 if a scenario's draw calls or CPU time per frame
+ * grew by more than threshold percent (default 10).
+ */
+#include "headless.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+struct Frame {
+    unsigned draw_calls;
+    unsigned state_changes;
+    double cpu_us;
+};
+
+/* Only touched on the render thread, between SDL_RenderClear and SDL_RenderPresent. */
+unsigned draw_calls = 0;
+unsigned state_changes = 0;
+double frame_cpu_start = 0;
+
+std::mutex frames_mutex;
+std::vector<Frame> frames;
+std::atomic<unsigned> presents { 0 };
+std::atomic<SDL_Window*> window { nullptr };
+std::atomic<Console_con*> con { nullptr };
+
+double thread_cpu_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int wrap_RenderClear(SDL_Renderer* r)
+{
+    frame_cpu_start = thread_cpu_us();
+    draw_calls = 1;
+    state_changes = 0;
+    return SDL_RenderClear(r);
+}
+
+void wrap_RenderPresent(SDL_Renderer* r)
+{
+    SDL_RenderPresent(r);
+    Frame f { draw_calls, state_changes, thread_cpu_us() - frame_cpu_start };
+    {
+        std::scoped_lock lock(frames_mutex);
+        frames.push_back(f);
+    }
+    presents++;
+}
+
+int wrap_RenderCopy(SDL_Renderer* r, SDL_Texture* t, const SDL_Rect* src, const SDL_Rect* dst)
+{
+    draw_calls++;
+    return SDL_RenderCopy(r, t, src, dst);
+}
+
+int wrap_RenderFillRect(SDL_Renderer* r, const SDL_Rect* rect)
+{
+    draw_calls++;
+    return SDL_RenderFillRect(r, rect);
+}
+
+int wrap_RenderFillRects(SDL_Renderer* r, const SDL_Rect* rects, int count)
+{
+    draw_calls++;
+    return SDL_RenderFillRects(r, rects, count);
+}
+
+int wrap_RenderDrawRect(SDL_Renderer* r, const SDL_Rect* rect)
+{
+    draw_calls++;
+    return SDL_RenderDrawRect(r, rect);
+}
+
+int wrap_SetRenderDrawColor(SDL_Renderer* r, Uint8 red, Uint8 g, Uint8 b, Uint8 a)
+{
+    state_changes++;
+    return SDL_SetRenderDrawColor(r, red, g, b, a);
+}
+
+int wrap_SetTextureColorMod(SDL_Texture* t, Uint8 r, Uint8 g, Uint8 b)
+{
+    state_changes++;
+    return SDL_SetTextureColorMod(t, r, g, b);
+}
+
+int wrap_SetRenderTarget(SDL_Renderer* r, SDL_Texture* t)
+{
+    state_changes++;
+    return SDL_SetRenderTarget(r, t);
+}
+
+int wrap_RenderSetViewport(SDL_Renderer* r, const SDL_Rect* rect)
+{
+    state_changes++;
+    return SDL_RenderSetViewport(r, rect);
+}
+
+int wrap_UpdateTexture(SDL_Texture* t, const SDL_Rect* rect, const void* pixels, int pitch)
+{
+    state_changes++;
+    return SDL_UpdateTexture(t, rect, pixels, pitch);
+}
+
+SDL_Window* wrap_CreateWindow(const char* title, int x, int y, int w, int h, Uint32 flags)
+{
+    SDL_Window* handle = SDL_CreateWindow(title, x, y, w, h, flags);
+    window = handle;
+    return handle;
+}
+
+/* The dummy driver never gives the window focus, and the console ignores input without it. */
+Uint32 wrap_GetWindowFlags(SDL_Window* w)
+{
+    return SDL_GetWindowFlags(w) | SDL_WINDOW_INPUT_FOCUS;
+}
+
+const std::map<std::string, void*> wrappers = {
+    { "SDL_RenderClear", (void*)wrap_RenderClear },
+    { "SDL_RenderPresent", (void*)wrap_RenderPresent },
+    { "SDL_RenderCopy", (void*)wrap_RenderCopy },
+    { "SDL_RenderFillRect", (void*)wrap_RenderFillRect },
+    { "SDL_RenderFillRects", (void*)wrap_RenderFillRects },
+    { "SDL_RenderDrawRect", (void*)wrap_RenderDrawRect },
+    { "SDL_SetRenderDrawColor", (void*)wrap_SetRenderDrawColor },
+    { "SDL_SetTextureColorMod", (void*)wrap_SetTextureColorMod },
+    { "SDL_SetRenderTarget", (void*)wrap_SetRenderTarget },
+    { "SDL_RenderSetViewport", (void*)wrap_RenderSetViewport },
+    { "SDL_UpdateTexture", (void*)wrap_UpdateTexture },
+    { "SDL_CreateWindow", (void*)wrap_CreateWindow },
+    { "SDL_GetWindowFlags", (void*)wrap_GetWindowFlags },
+};
+
+void* resolve(const char* name)
+{
+    auto it = wrappers.find(name);
+    if (it != wrappers.end())
+        return it->second;
+    return dlsym(RTLD_DEFAULT, name);
+}
+
+/* Wait until the render thread presents n more frames, or give up after a second. */
+void wait_frames(unsigned n)
+{
+    unsigned target = presents + n;
+    for (int i = 0; i < 1000 && presents < target; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void push(SDL_Event e)
+{
+    SDL_PushEvent(&e);
+}
+
+SDL_Event mouse_button(Uint32 type, int x, int y)
+{
+    SDL_Event e {};
+    e.type = type;
+    e.button.windowID = SDL_GetWindowID(window);
+    e.button.button = SDL_BUTTON_LEFT;
+    e.button.state = type == SDL_MOUSEBUTTONDOWN ? SDL_PRESSED : SDL_RELEASED;
+    e.button.clicks = 1;
+    e.button.x = x;
+    e.button.y = y;
+    return e;
+}
+
+SDL_Event mouse_motion(int x, int y)
+{
+    SDL_Event e {};
+    e.type = SDL_MOUSEMOTION;
+    e.motion.windowID = SDL_GetWindowID(window);
+    e.motion.state = SDL_BUTTON_LMASK;
+    e.motion.x = x;
+    e.motion.y = y;
+    return e;
+}
+
+SDL_Event wheel(int y)
+{
+    SDL_Event e {};
+    e.type = SDL_MOUSEWHEEL;
+    e.wheel.windowID = SDL_GetWindowID(window);
+    e.wheel.y = y;
+    return e;
+}
+
+SDL_Event resized(int w, int h)
+{
+    SDL_Event e {};
+    e.type = SDL_WINDOWEVENT;
+    e.window.windowID = SDL_GetWindowID(window);
+    e.window.event = SDL_WINDOWEVENT_RESIZED;
+    e.window.data1 = w;
+    e.window.data2 = h;
+    return e;
+}
+
+constexpr int steps = 60;
+
+const char* lorem = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed tincidunt, odio quis "
+                    "pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo.";
+
+void fill(int lines)
+{
+    Console_Clear(con);
+    for (int i = 0; i < lines; ++i)
+        Console_AddLine(con, lorem);
+    wait_frames(2);
+}
+
+/* Every frame redraws a screen full of wrapped text with one new line. */
+void full_screen()
+{
+    fill(Console_GetRows(con) * 2);
+    for (int i = 0; i < steps; ++i) {
+        Console_AddLine(con, lorem);
+        wait_frames(1);
+    }
+}
+
+void scrolling()
+{
+    fill(2000);
+    for (int i = 0; i < steps; ++i) {
+        push(wheel(i < steps / 2 ? 3 : -3));
+        wait_frames(1);
+    }
+}
+
+void selection()
+{
+    fill(Console_GetRows(con) * 2);
+    int w, h;
+    SDL_GetWindowSize(window, &w, &h);
+    push(mouse_button(SDL_MOUSEBUTTONDOWN, 4, 40));
+    for (int i = 0; i < steps; ++i) {
+        push(mouse_motion(4 + (w - 8) * i / steps, 40 + (h - 80) * i / steps));
+        wait_frames(1);
+    }
+    push(mouse_button(SDL_MOUSEBUTTONUP, w - 4, h - 40));
+    wait_frames(1);
+}
+
+void resize()
+{
+    fill(500);
+    for (int i = 0; i < steps; ++i) {
+        int w = i % 2 ? 640 : 1024, h = i % 2 ? 480 : 768;
+        SDL_SetWindowSize(window, w, h);
+        push(resized(w, h));
+        wait_frames(1);
+    }
+    SDL_SetWindowSize(window, 640, 480);
+    push(resized(640, 480));
+    wait_frames(1);
+}
+
+struct Result {
+    std::string name;
+    size_t frames = 0;
+    double draw_calls = 0;
+    double state_changes = 0;
+    double cpu_us = 0;
+    double max_cpu_us = 0;
+};
+
+Result run(const char* name, void (*scenario)())
+{
+    {
+        std::scoped_lock lock(frames_mutex);
+        frames.clear();
+    }
+    scenario();
+
+    std::scoped_lock lock(frames_mutex);
+    Result r;
+    r.name = name;
+    r.frames = frames.size();
+    for (auto& f : frames) {
+        r.draw_calls += f.draw_calls;
+        r.state_changes += f.state_changes;
+        r.cpu_us += f.cpu_us;
+        r.max_cpu_us = std::max(r.max_cpu_us, f.cpu_us);
+    }
+    if (r.frames) {
+        r.draw_calls /= r.frames;
+        r.state_changes /= r.frames;
+        r.cpu_us /= r.frames;
+    }
+    return r;
+}
+
+/* Reads back the output of a previous run, one scenario per line. */
+std::vector<Result> read_baseline(const char* path)
+{
+    std::vector<Result> results;
+    FILE* f = std::fopen(path, "r");
+    if (!f)
+        return results;
+    char line[512];
+    while (std::fgets(line, sizeof(line), f)) {
+        char name[64];
+        Result r;
+        if (std::sscanf(line, " {\"name\": \"%63[^\"]\", \"frames\": %zu, \"draw_calls_per_frame\": %lf, "
+                              "\"state_changes_per_frame\": %lf, \"cpu_us_per_frame\": %lf",
+                name, &r.frames, &r.draw_calls, &r.state_changes, &r.cpu_us)
+            == 5) {
+            r.name = name;
+            results.push_back(r);
+        }
+    }
+    std::fclose(f);
+    return results;
+}
+
+int compare(const std::vector<Result>& results, const std::vector<Result>& baseline, double threshold)
+{
+    int regressions = 0;
+    auto check = [&](const std::string& name, const char* what, double now, double base) {
+        if (base > 0 && now > base * (1 + threshold / 100)) {
+            std::fprintf(stderr, "%s: %s %.1f, baseline %.1f (+%.0f%%)\n", name.c_str(), what, now, base,
+                (now / base - 1) * 100);
+            regressions++;
+        }
+    };
+    for (auto& r : results) {
+        for (auto& b : baseline) {
+            if (b.name != r.name)
+                continue;
+            check(r.name, "draw calls per frame", r.draw_calls, b.draw_calls);
+            check(r.name, "state changes per frame", r.state_changes, b.state_changes);
+            check(r.name, "cpu us per frame", r.cpu_us, b.cpu_us);
+        }
+    }
+    return regressions;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const char* baseline_path = nullptr;
+    double threshold = 10;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--baseline") && i + 1 < argc)
+            baseline_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--threshold") && i + 1 < argc)
+            threshold = std::atof(argv[++i]);
+        else {
+            std::fprintf(stderr, "usage: %s [--baseline file] [--threshold percent]\n", argv[0]);
+            return 2;
+        }
+    }
+    std::vector<Result> baseline;
+    if (baseline_path) {
+        baseline = read_baseline(baseline_path);
+        if (baseline.empty()) {
+            std::fprintf(stderr, "no results in %s\n", baseline_path);
+            return 2;
+        }
+    }
+
+    Console_Init(resolve);
+    HeadlessConsole console("render bench");
+    con = console.con;
+    wait_frames(1);
+
+    std::vector<Result> results;
+    results.push_back(run("full_screen", full_screen));
+    results.push_back(run("scrolling", scrolling));
+    results.push_back(run("selection", selection));
+    results.push_back(run("resize", resize));
+
+    std::printf("{\"scenarios\": [");
+    const char* separator = "";
+    for (auto& r : results) {
+        std::printf("%s\n    {\"name\": \"%s\", \"frames\": %zu, \"draw_calls_per_frame\": %.1f, "
+                    "\"state_changes_per_frame\": %.1f, \"cpu_us_per_frame\": %.1f, \"max_cpu_us\": %.1f}",
+            separator, r.name.c_str(), r.frames, r.draw_calls, r.state_changes, r.cpu_us, r.max_cpu_us);
+        separator = ",";
+    }
+    std::printf("\n]}\n");
+
+    return compare(results, baseline, threshold) ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * Multi-producer stress test. Producer threads add lines to a headless
+ * console (headless.h) at a fixed rate while a monitor polls
+ * Console_GetStats(). Reports sustained lines/s, the time from adding a
+ * line to the first present that shows it, the API queue high water,
+ * dropped lines and RSS over time, as JSON.
+ *
+ *   make stress && ./stress --producers 8 --rate 0 --seconds 10
+ *
+ *   --producers N   producer threads (4)
+ *   --rate R        lines/s per producer, 0 for as fast as possible (1000)
+ *   --seconds S     how long to produce for (5)
+ *   --length A:B    line lengths, uniform between A and B bytes (20:200)
+ *   --batch B       lines per Console_AddLines() call, 1 uses Console_AddLine() (1)
+ */
+#include "headless.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int producers = 4;
+    double rate = 1000;
+    double seconds = 5;
+    int min_length = 20;
+    int max_length = 200;
+    int batch = 1;
+};
+
+struct Sent {
+    Console_LineId id;
+    Clock::time_point time;
+};
+
+struct Presented {
+    Clock::time_point time;
+    Console_LineId through;
+};
+
+struct Sample {
+    double t;
+    unsigned long long rss_kib;
+    unsigned long long queue_depth;
+    unsigned long long scrollback_kib;
+};
+
+const char* lorem = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed tincidunt, odio quis "
+                    "pulvinar suscipit, dolor nibh lobortis massa, quis sollicitudin ipsum sapien nec leo. ";
+
+unsigned long long rss_kib()
+{
+    unsigned long long pages = 0, resident = 0;
+    if (FILE* f = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(f, "%llu %llu", &pages, &resident) != 2)
+            resident = 0;
+        std::fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+std::vector<Sent> produce(Console_con* con, const Options& o, int seed, Clock::time_point end)
+{
+    std::vector<Sent> sent;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> length(o.min_length, o.max_length);
+    std::string text;
+    while (text.size() < static_cast<size_t>(o.max_length) * 2)
+        text += lorem;
+
+    std::vector<std::string> lines(o.batch);
+    std::vector<const char*> ptrs(o.batch);
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(o.rate > 0 ? o.batch / o.rate : 0));
+    auto next = Clock::now();
+    while (Clock::now() < end) {
+        for (int i = 0; i < o.batch; ++i) {
+            size_t n = length(rng);
+            lines[i].assign(text, rng() % (text.size() - n), n);
+            ptrs[i] = lines[i].c_str();
+        }
+        auto now = Clock::now();
+        Console_LineId first = o.batch == 1 ? Console_AddLine(con, ptrs[0])
+                                            : Console_AddLines(con, ptrs.data(), o.batch);
+        for (int i = 0; i < o.batch; ++i)
+            sent.push_back({ first + i, now });
+
+        if (o.rate > 0) {
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+    }
+    return sent;
+}
+
+double percentile(const std::vector<double>& sorted, double q)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))];
+}
+
+bool parse(int argc, char** argv, Options& o)
+{
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* v = argv[i + 1];
+        if (!std::strcmp(argv[i], "--producers"))
+            o.producers = std::max(1, std::atoi(v));
+        else if (!std::strcmp(argv[i], "--rate"))
+            o.rate = std::atof(v);
+        else if (!std::strcmp(argv[i], "--seconds"))
+            o.seconds = std::atof(v);
+        else if (!std::strcmp(argv[i], "--length")) {
+            if (std::sscanf(v, "%d:%d", &o.min_length, &o.max_length) != 2)
+                return false;
+        } else if (!std::strcmp(argv[i], "--batch"))
+            o.batch = std::max(1, std::atoi(v));
+        else
+            return false;
+    }
+    o.min_length = std::max(1, o.min_length);
+    o.max_length = std::max(o.min_length, o.max_length);
+    return argc % 2 == 1;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options o;
+    if (!parse(argc, argv, o)) {
+        std::fprintf(stderr, "usage: %s [--producers N] [--rate lines/s] [--seconds S] [--length A:B] [--batch B]\n", argv[0]);
+        return 2;
+    }
+
+    HeadlessConsole console("stress");
+    Console_con* con = console.con;
+
+    // Poll the presented line id every millisecond, which bounds the
+    // error of the latencies; sample memory every 100ms.
+    std::vector<Presented> presents;
+    std::vector<Sample> samples;
+    std::atomic<bool> monitoring { true };
+    auto start = Clock::now();
+    std::thread monitor([&] {
+        Console_LineId through = 0;
+        auto next_sample = start;
+        while (monitoring) {
+            Console_Stats stats;
+            Console_GetStats(con, &stats);
+            auto now = Clock::now();
+            if (stats.last_line_presented > through) {
+                through = stats.last_line_presented;
+                presents.push_back({ now, through });
+            }
+            if (now >= next_sample) {
+                samples.push_back({ std::chrono::duration<double>(now - start).count(), rss_kib(),
+                    stats.api_queue_depth, stats.scrollback_bytes / 1024 });
+                next_sample += std::chrono::milliseconds(100);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(o.seconds));
+    std::vector<std::vector<Sent>> sent(o.producers);
+    std::vector<std::thread> producers;
+    for (int i = 0; i < o.producers; ++i)
+        producers.emplace_back([&, i] { sent[i] = produce(con, o, i + 1, end); });
+    for (auto& t : producers)
+        t.join();
+    auto produced = Clock::now();
+
+    // Let the console catch up, for at most as long again
+    Console_LineId newest = 0;
+    size_t total = 0;
+    for (auto& s : sent) {
+        total += s.size();
+        for (auto& line : s)
+            newest = std::max(newest, line.id);
+    }
+    auto drain_end = produced + (produced - start);
+    while (Clock::now() < drain_end) {
+        Console_Stats stats;
+        Console_GetStats(con, &stats);
+        if (stats.last_line_presented >= newest)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto drained = Clock::now();
+    monitoring = false;
+    monitor.join();
+
+    std::vector<double> latencies;
+    latencies.reserve(total);
+    for (auto& s : sent) {
+        for (auto& line : s) {
+            auto it = std::lower_bound(presents.begin(), presents.end(), line.id,
+                [](const Presented& p, Console_LineId id) { return p.through < id; });
+            if (it != presents.end())
+                latencies.push_back(std::chrono::duration<double, std::milli>(it->time - line.time).count());
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    Console_Stats stats;
+    Console_GetStats(con, &stats);
+    double produce_s = std::chrono::duration<double>(produced - start).count();
+    double drain_s = std::chrono::duration<double>(drained - start).count();
+
+    std::printf("{\n    \"producers\": %d, \"rate\": %.0f, \"seconds\": %.1f, \"length\": [%d, %d], \"batch\": %d,\n",
+        o.producers, o.rate, o.seconds, o.min_length, o.max_length, o.batch);
+    std::printf("    \"lines_sent\": %zu, \"lines_presented\": %zu, \"sent_per_sec\": %.0f, \"presented_per_sec\": %.0f,\n",
+        total, latencies.size(), total / produce_s, latencies.size() / drain_s);
+    std::printf("    \"latency_ms\": {\"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f},\n",
+        percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99),
+        latencies.empty() ? 0.0 : latencies.back());
+    std::printf("    \"api_queue_high_water\": %llu, \"lines_dropped\": %llu, \"frames_rendered\": %llu, \"scrollback_kib\": %llu,\n",
+        stats.api_queue_high_water, stats.lines_dropped, stats.frames_rendered, stats.scrollback_bytes / 1024);
+    std::printf("    \"samples\": [");
+    const char* separator = "";
+    for (auto& s : samples) {
+        std::printf("%s\n        {\"t\": %.1f, \"rss_kib\": %llu, \"queue_depth\": %llu, \"scrollback_kib\": %llu}",
+            separator, s.t, s.rss_kib, s.queue_depth, s.scrollback_kib);
+        separator = ",";
+    }
+    std::printf("\n    ]\n}\n");
+    return 0;
+}